@@ -0,0 +1,302 @@
+/// \file QTRAcquisition.h
+
+#pragma once
+
+#include <Arduino.h>
+#include "QTRSensors.h"
+
+/// \brief A set of sensor readings captured by QTRAcquisition.
+template <uint8_t SensorCount>
+struct QTRFrame
+{
+  /// The time (as returned by `micros()`) when the read started.
+  uint32_t timestamp;
+
+  /// The sensor readings, as returned by QTRSensors::read() or
+  /// QTRSensors::readCalibrated().
+  uint16_t values[SensorCount];
+};
+
+/// \brief Reads a QTR sensor array in the background.
+///
+/// \tparam SensorCount The number of sensors, which must match the number
+/// passed to QTRSensors::setSensorPins().
+///
+/// \tparam FrameCount The number of frames that can be waiting to be
+/// retrieved with read(). The default is 4.
+///
+/// This class reads the sensors at a fixed rate, regardless of what the rest
+/// of your program is doing. Instead of owning a hardware timer itself, it is
+/// driven by calls to tick(), which you should make from a periodic timer
+/// interrupt (or any other periodic callback). Each call to tick() advances
+/// the current read with QTRSensors::poll(), and completed readings are
+/// stored as timestamped QTRFrame structs in a ring buffer that your main
+/// loop drains with read().
+///
+/// The ring buffer is safe to use with a single producer (tick()) and a
+/// single consumer (read()) without disabling interrupts.
+///
+/// Example usage:
+/// ~~~{.cpp}
+/// QTRSensors qtr;
+/// QTRAcquisition<8> acquisition(qtr);
+///
+/// // called every 100 us by a timer interrupt
+/// void onTimer()
+/// {
+///   acquisition.tick();
+/// }
+///
+/// void setup()
+/// {
+///   // configure qtr and the timer here
+///   acquisition.begin(QTRReadMode::On);
+/// }
+///
+/// void loop()
+/// {
+///   QTRFrame<8> frame;
+///   while (acquisition.read(frame))
+///   {
+///     // use frame.values and frame.timestamp here
+///   }
+/// }
+/// ~~~
+///
+/// While acquisition is running, the QTRSensors object it uses belongs to
+/// tick(): do not read, calibrate, or control the emitters of that object
+/// from elsewhere until you call end().
+template <uint8_t SensorCount, uint8_t FrameCount = 4>
+class QTRAcquisition
+{
+  public:
+
+    /// \brief The type of frame stored by this class.
+    typedef QTRFrame<SensorCount> Frame;
+
+    /// \brief Constructs an object that reads the given sensors.
+    ///
+    /// \param sensors The sensor array to read.
+    explicit QTRAcquisition(QTRSensors & sensors) : _sensors(sensors) {}
+
+    /// \brief Starts background acquisition.
+    ///
+    /// \param mode The emitter behavior during each read, as a member of the
+    /// ::QTRReadMode enum. The default is QTRReadMode::On.
+    ///
+    /// \param calibrated If true, frames hold calibrated values (see
+    /// QTRSensors::readCalibrated()); otherwise, they hold raw values. The
+    /// default is false. If the sensors have not been calibrated for \p mode,
+    /// no frames are captured.
+    ///
+    /// \param framePeriod The number of calls to tick() from the start of one
+    /// read to the start of the next. If a read takes longer than this, the
+    /// next one starts on the tick after it finishes. The default is 1, which
+    /// reads the sensors continuously.
+    ///
+    /// \return True if acquisition was started, or false if the sensor array
+    /// has more sensors than \p SensorCount, so that its readings would not
+    /// fit in a frame (see QTRSensors::getSensorCount()).
+    ///
+    /// If acquisition is already running, it is ended first (see end()). Any
+    /// frames that have not been retrieved with read() are discarded.
+    bool begin(QTRReadMode mode = QTRReadMode::On, bool calibrated = false,
+               uint16_t framePeriod = 1)
+    {
+      return beginPrivate(false, nullptr, mode, calibrated, framePeriod);
+    }
+
+    /// \brief Starts background acquisition of some of the sensors.
+    ///
+    /// \param mask The sensors to read for each frame, as for
+    /// QTRSensors::readMasked(). The array must remain valid until
+    /// acquisition ends.
+    ///
+    /// \param mode As for begin().
+    ///
+    /// \param calibrated As for begin().
+    ///
+    /// \param framePeriod As for begin().
+    ///
+    /// \return As for begin().
+    ///
+    /// This works like begin(), but each read only takes the time needed for
+    /// the selected sensors (see QTRSensors::startReadMasked()). The entries
+    /// of each frame's values for the other sensors are not meaningful. If \p
+    /// mask does not select any sensors, no frames are captured.
+    bool beginMasked(const uint8_t * mask, QTRReadMode mode = QTRReadMode::On,
+                     bool calibrated = false, uint16_t framePeriod = 1)
+    {
+      return beginPrivate(true, mask, mode, calibrated, framePeriod);
+    }
+
+    /// \brief Stops background acquisition.
+    ///
+    /// Any read in progress is abandoned (see QTRSensors::cancelRead()), and
+    /// the emitters are turned off. Frames that have already been captured
+    /// can still be retrieved with read().
+    void end()
+    {
+      _running = false;
+
+      if (_reading)
+      {
+        _reading = false;
+        _sensors.cancelRead();
+        _sensors.emittersOff();
+      }
+    }
+
+    /// \brief Returns whether background acquisition is running.
+    bool isRunning() { return _running; }
+
+    /// \brief Advances background acquisition.
+    ///
+    /// Call this function at a fixed rate, typically from a timer interrupt.
+    /// Each call does a small, bounded amount of work, except that analog
+    /// sensors take one sample per sensor on each call.
+    ///
+    /// On AVR and ARM Cortex-M boards, the library leaves interrupts the way
+    /// it finds them after briefly disabling them, so tick() does not enable
+    /// interrupts inside an interrupt handler.
+    ///
+    /// If a call to tick() interrupts another one (for example, because
+    /// interrupts were re-enabled while it was running), it returns without
+    /// doing anything.
+    void tick()
+    {
+      if (!_running || _busy) { return; }
+      _busy = true;
+
+      if (_ticksUntilFrame > 0) { _ticksUntilFrame--; }
+
+      if (!_reading && (_ticksUntilFrame == 0))
+      {
+        // Start the next frame in the free slot at the head of the buffer.
+        Frame & frame = _frames[_head];
+        frame.timestamp = micros();
+
+        // If the read can't be started (for example, because calibrated
+        // frames were requested but the sensors have not been calibrated),
+        // skip this frame instead of publishing values that were not read.
+        if (_masked && _calibrated)
+        {
+          _reading = _sensors.startReadCalibratedMasked(frame.values, _mask, _mode);
+        }
+        else if (_masked)
+        {
+          _reading = _sensors.startReadMasked(frame.values, _mask, _mode);
+        }
+        else if (_calibrated)
+        {
+          _reading = _sensors.startReadCalibrated(frame.values, _mode);
+        }
+        else
+        {
+          _reading = _sensors.startRead(frame.values, _mode);
+        }
+        _ticksUntilFrame = _framePeriod;
+      }
+
+      if (_reading && _sensors.poll())
+      {
+        _reading = false;
+
+        uint8_t next = nextIndex(_head);
+        if (next == _tail)
+        {
+          // The buffer is full; drop this frame.
+          _droppedFrames++;
+        }
+        else
+        {
+          // make sure the frame is written before it is published
+          barrier();
+          _head = next;
+        }
+      }
+
+      _busy = false;
+    }
+
+    /// \brief Returns whether any frames are waiting to be retrieved.
+    bool available() { return _head != _tail; }
+
+    /// \brief Retrieves the oldest captured frame.
+    ///
+    /// \param[out] frame The frame.
+    ///
+    /// \return True if a frame was retrieved, false if none were waiting.
+    bool read(Frame & frame)
+    {
+      uint8_t tail = _tail;
+      if (tail == _head) { return false; }
+
+      // make sure the frame is read after checking that it is published
+      barrier();
+      frame = _frames[tail];
+      barrier();
+
+      _tail = nextIndex(tail);
+      return true;
+    }
+
+    /// \brief Returns the number of frames dropped because the buffer was
+    /// full.
+    ///
+    /// The count is reset by begin().
+    uint16_t getDroppedFrames() { return _droppedFrames; }
+
+  private:
+
+    bool beginPrivate(bool masked, const uint8_t * mask, QTRReadMode mode,
+                      bool calibrated, uint16_t framePeriod)
+    {
+      // Abandon any read in progress so that it doesn't write to a frame
+      // after the buffer is reset.
+      end();
+
+      if (_sensors.getSensorCount() > SensorCount) { return false; }
+
+      _masked = masked;
+      _mask = mask;
+      _mode = mode;
+      _calibrated = calibrated;
+      _framePeriod = framePeriod;
+      _ticksUntilFrame = 0;
+      _reading = false;
+      _head = 0;
+      _tail = 0;
+      _droppedFrames = 0;
+
+      _running = true;
+      return true;
+    }
+
+    static uint8_t nextIndex(uint8_t index)
+    {
+      return (index + 1 < FrameCount + 1) ? (index + 1) : 0;
+    }
+
+    // Keeps the compiler from moving memory accesses across this point.
+    static void barrier() { __asm__ __volatile__("" ::: "memory"); }
+
+    QTRSensors & _sensors;
+
+    // One slot is always free, so the buffer holds FrameCount frames.
+    Frame _frames[FrameCount + 1];
+    volatile uint8_t _head = 0; // written only by tick()
+    volatile uint8_t _tail = 0; // written only by read()
+
+    bool _masked = false;
+    const uint8_t * _mask = nullptr;
+    QTRReadMode _mode = QTRReadMode::On;
+    bool _calibrated = false;
+    uint16_t _framePeriod = 1;
+    uint16_t _ticksUntilFrame = 0;
+    volatile uint16_t _droppedFrames = 0;
+
+    volatile bool _running = false;
+    volatile bool _busy = false;
+    volatile bool _reading = false;
+};
@@ -0,0 +1,79 @@
+#include "QTRSensorGroup.h"
+
+bool QTRSensorGroup::readPrivate(uint16_t * const * sensorValues,
+                                 const uint8_t * const * masks,
+                                 QTRReadMode mode, bool calibrated)
+{
+  bool started = true;
+
+  for (uint8_t k = 0; k < _count; k++)
+  {
+    // An object whose read can't be started finishes right away; the others
+    // are still read.
+    if (masks != nullptr)
+    {
+      if (calibrated)
+      {
+        started &= _sensors[k]->startReadCalibratedMasked(sensorValues[k], masks[k], mode);
+      }
+      else
+      {
+        started &= _sensors[k]->startReadMasked(sensorValues[k], masks[k], mode);
+      }
+    }
+    else if (calibrated)
+    {
+      started &= _sensors[k]->startReadCalibrated(sensorValues[k], mode);
+    }
+    else
+    {
+      started &= _sensors[k]->startRead(sensorValues[k], mode);
+    }
+  }
+
+  // Advance all of the reads in turn, so that each step (switching the
+  // emitters, waiting for them to settle, and scanning the sensors) happens
+  // at about the same time for every object.
+  bool done;
+  do
+  {
+    done = true;
+    for (uint8_t k = 0; k < _count; k++)
+    {
+      if (!_sensors[k]->poll()) { done = false; }
+    }
+  } while (!done);
+
+  // A read can also finish without reading if there turns out to be nothing
+  // to scan.
+  for (uint8_t k = 0; k < _count; k++)
+  {
+    if (_sensors[k]->_readState != QTRSensors::ReadState::Done) { started = false; }
+  }
+
+  return started;
+}
+
+bool QTRSensorGroup::readLinePrivate(uint16_t * const * sensorValues,
+                                     QTRPosition * positions,
+                                     QTRReadMode mode, bool invertReadings)
+{
+  // manual emitter control is not supported
+  if (mode == QTRReadMode::Manual)
+  {
+    for (uint8_t k = 0; k < _count; k++) { positions[k] = 0; }
+    return false;
+  }
+
+  bool read = readPrivate(sensorValues, nullptr, mode, true);
+
+  for (uint8_t k = 0; k < _count; k++)
+  {
+    // skip the objects that were not read, whose values were not changed
+    if (_sensors[k]->_readState != QTRSensors::ReadState::Done) { continue; }
+
+    positions[k] = _sensors[k]->linePosition(sensorValues[k], invertReadings);
+  }
+
+  return read;
+}
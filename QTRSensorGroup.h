@@ -0,0 +1,181 @@
+/// \file QTRSensorGroup.h
+
+#pragma once
+
+#include "QTRSensors.h"
+
+/// \brief Reads several QTR sensor arrays at the same time.
+///
+/// If your robot has more than one QTRSensors object (for example, one for
+/// the front sensors and one for the rear sensors), reading them one after
+/// another with read() takes the emitter settling time and (for RC sensors)
+/// the timeout once for each of them. This class reads all of them together
+/// instead: their emitters are switched one right after another and settle at
+/// the same time, and their RC sensors are charged, released, and timed in
+/// the same discharge window, so reading the whole group takes about as long
+/// as reading one of them.
+///
+/// Each QTRSensors object keeps its own configuration, calibration, and line
+/// position, so calibrate them individually with QTRSensors::calibrate().
+///
+/// Example usage:
+/// ~~~{.cpp}
+/// QTRSensors front, rear;
+/// QTRSensors * const arrays[] = {&front, &rear};
+/// QTRSensorGroup group(arrays, 2);
+///
+/// uint16_t frontValues[8], rearValues[8];
+/// uint16_t * const values[] = {frontValues, rearValues};
+/// QTRPosition positions[2];
+///
+/// void loop()
+/// {
+///   group.readLineBlack(values, positions);
+///   // positions[0] is the line position seen by the front sensors, and
+///   // positions[1] is the one seen by the rear sensors
+/// }
+/// ~~~
+///
+/// The objects are read with QTRSensors::startRead() and QTRSensors::poll(),
+/// so they follow the same settings as those functions. Only one object at a
+/// time can use QTRRCTiming::Interrupt; the others fall back to polling.
+class QTRSensorGroup
+{
+  public:
+
+    /// \brief Constructs a group of sensor arrays.
+    ///
+    /// \param sensors An array of pointers to the QTRSensors objects in the
+    /// group. The array (and the objects) must remain valid while the group
+    /// is used.
+    ///
+    /// \param count The number of objects in the group.
+    QTRSensorGroup(QTRSensors * const * sensors, uint8_t count) :
+      _sensors(sensors), _count(count) {}
+
+    /// \brief Returns the number of sensor arrays in the group.
+    uint8_t getCount() { return _count; }
+
+    /// \brief Reads the raw sensor values of every array in the group.
+    ///
+    /// \param[out] sensorValues An array of pointers, one for each object in
+    /// the group, to arrays in which to store that object's readings (as
+    /// described for QTRSensors::read()).
+    ///
+    /// \param mode The emitter behavior during the read, as a member of the
+    /// ::QTRReadMode enum. The default is QTRReadMode::On.
+    ///
+    /// \return True if every object was read, or false if the read of any of
+    /// them could not be started (see QTRSensors::startRead()). The values of
+    /// those objects are left unchanged; the others are still read.
+    bool read(uint16_t * const * sensorValues, QTRReadMode mode = QTRReadMode::On)
+    {
+      return readPrivate(sensorValues, nullptr, mode, false);
+    }
+
+    /// \brief Reads the calibrated sensor values of every array in the group.
+    ///
+    /// \param[out] sensorValues An array of pointers, one for each object in
+    /// the group, to arrays in which to store that object's calibrated
+    /// readings (as described for QTRSensors::readCalibrated()).
+    ///
+    /// \param mode The emitter behavior during the read, as a member of the
+    /// ::QTRReadMode enum. The default is QTRReadMode::On.
+    ///
+    /// \return As for read(). This is false if any of the objects has not
+    /// been calibrated for \p mode, and the values of those objects are left
+    /// unchanged.
+    bool readCalibrated(uint16_t * const * sensorValues, QTRReadMode mode = QTRReadMode::On)
+    {
+      return readPrivate(sensorValues, nullptr, mode, true);
+    }
+
+    /// \brief Reads the raw values of some of the sensors of every array in
+    /// the group.
+    ///
+    /// \param[out] sensorValues As for read().
+    ///
+    /// \param masks An array of pointers, one for each object in the group,
+    /// to masks selecting the sensors of that object to read as described for
+    /// QTRSensors::readMasked().
+    ///
+    /// \param mode The emitter behavior during the read, as a member of the
+    /// ::QTRReadMode enum. The default is QTRReadMode::On.
+    ///
+    /// \return As for read(). This is false if the mask of any of the objects
+    /// does not select any sensors.
+    ///
+    /// The entries of \p sensorValues for the sensors that are not selected
+    /// are left unchanged, as are all of the values of an object whose mask
+    /// does not select any sensors.
+    bool readMasked(uint16_t * const * sensorValues,
+                    const uint8_t * const * masks,
+                    QTRReadMode mode = QTRReadMode::On)
+    {
+      return readPrivate(sensorValues, masks, mode, false);
+    }
+
+    /// \brief Reads calibrated values of some of the sensors of every array
+    /// in the group.
+    ///
+    /// \param[out] sensorValues As for readCalibrated().
+    ///
+    /// \param masks The sensors to read, as for readMasked().
+    ///
+    /// \param mode The emitter behavior during the read, as a member of the
+    /// ::QTRReadMode enum. The default is QTRReadMode::On.
+    ///
+    /// \return As for readMasked() and readCalibrated().
+    ///
+    /// See readMasked() and readCalibrated().
+    bool readCalibratedMasked(uint16_t * const * sensorValues,
+                              const uint8_t * const * masks,
+                              QTRReadMode mode = QTRReadMode::On)
+    {
+      return readPrivate(sensorValues, masks, mode, true);
+    }
+
+    /// \brief Reads every array in the group, provides calibrated values, and
+    /// returns the estimated black line position seen by each one.
+    ///
+    /// \param[out] sensorValues As for readCalibrated().
+    ///
+    /// \param[out] positions An array in which to store the line position
+    /// for each object in the group, as returned by
+    /// QTRSensors::readLineBlack().
+    ///
+    /// \param mode The emitter behavior during the read, as a member of the
+    /// ::QTRReadMode enum. The default is QTRReadMode::On. Manual emitter
+    /// control with QTRReadMode::Manual is not supported.
+    ///
+    /// \return As for readCalibrated(). The positions of the objects that
+    /// could not be read are left unchanged. With QTRReadMode::Manual, every
+    /// position is set to 0 and this returns false.
+    bool readLineBlack(uint16_t * const * sensorValues, QTRPosition * positions,
+                       QTRReadMode mode = QTRReadMode::On)
+    {
+      return readLinePrivate(sensorValues, positions, mode, false);
+    }
+
+    /// \brief Reads every array in the group, provides calibrated values, and
+    /// returns the estimated white line position seen by each one.
+    ///
+    /// See readLineBlack() and QTRSensors::readLineWhite().
+    bool readLineWhite(uint16_t * const * sensorValues, QTRPosition * positions,
+                       QTRReadMode mode = QTRReadMode::On)
+    {
+      return readLinePrivate(sensorValues, positions, mode, true);
+    }
+
+  private:
+
+    // Reads the sensors selected by masks (all of them if masks is nullptr).
+    bool readPrivate(uint16_t * const * sensorValues,
+                     const uint8_t * const * masks,
+                     QTRReadMode mode, bool calibrated);
+    bool readLinePrivate(uint16_t * const * sensorValues, QTRPosition * positions,
+                         QTRReadMode mode, bool invertReadings);
+
+    QTRSensors * const * _sensors;
+    uint8_t _count;
+};
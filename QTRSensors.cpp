@@ -1,29 +1,120 @@
 #include "QTRSensors.h"
 #include <Arduino.h>
 
+// These record timing statistics for the phases of a reading (see
+// getPhaseStats()), or compile to nothing if QTR_TIMING_STATS is disabled.
+// QTR_TIME_PHASE times the rest of the enclosing block.
+#if QTR_TIMING_STATS
+#define QTR_RECORD_PHASE(phase, start) recordPhase((phase), (start))
+#define QTR_TIME_PHASE(phase) PhaseTimer phaseTimer(*this, (phase))
+#else
+#define QTR_RECORD_PHASE(phase, start) ((void)0)
+#define QTR_TIME_PHASE(phase) ((void)0)
+#endif
+
+// These disable interrupts and then put them back the way they were, instead
+// of always enabling them afterward, so that code that runs with interrupts
+// disabled (such as a timer interrupt calling QTRAcquisition::tick()) does not
+// have them enabled behind its back. Elsewhere, where the state can't be read
+// this way, interrupts are enabled as with interrupts().
+#if defined(__AVR__)
+typedef uint8_t InterruptState;
+
+static inline InterruptState disableInterrupts()
+{
+  InterruptState state = SREG;
+  cli();
+  return state;
+}
+
+static inline void restoreInterrupts(InterruptState state)
+{
+  SREG = state;
+}
+#elif defined(__ARM_ARCH_PROFILE) && (__ARM_ARCH_PROFILE == 'M')
+typedef uint32_t InterruptState;
+
+static inline InterruptState disableInterrupts()
+{
+  InterruptState state;
+  __asm__ __volatile__("mrs %0, primask\n\tcpsid i" : "=r" (state) :: "memory");
+  return state;
+}
+
+static inline void restoreInterrupts(InterruptState state)
+{
+  __asm__ __volatile__("msr primask, %0" :: "r" (state) : "memory");
+}
+#else
+typedef uint8_t InterruptState;
+
+static inline InterruptState disableInterrupts()
+{
+  noInterrupts();
+  return 0;
+}
+
+static inline void restoreInterrupts(InterruptState)
+{
+  interrupts();
+}
+#endif
+
+#if QTR_PIN_TABLES
+constexpr uint8_t QTRPinTable::Entries[];
+#endif
+
+// (Re)allocates an array to hold count elements. If allocation fails, any
+// memory used by the old array is deallocated and false is returned.
+//
+// If a buffer has been set with setBuffer(), the array already points into it
+// (or is nullptr if the buffer does not include it), so this only checks that
+// the array exists and count elements fit.
+template <typename T>
+bool QTRSensors::allocateArray(T * & array, uint8_t count)
+{
+  if (_bufferCapacity != 0) { return (array != nullptr) && (count <= _bufferCapacity); }
+
+  T * oldArray = array;
+  array = (T *)realloc(array, sizeof(T) * count);
+  if (array == nullptr)
+  {
+    free(oldArray);
+    return false;
+  }
+  return true;
+}
+
 void QTRSensors::setTypeRC()
 {
   _type = QTRType::RC;
   _maxValue = _timeout;
+  _calibrationCombined.initialized = false; // depends on _maxValue
+  _offValuesValid = false;
 }
 
 void QTRSensors::setTypeAnalog()
 {
   _type = QTRType::Analog;
-  _maxValue = 1023; // Arduino analogRead() returns a 10-bit value by default
+  // Arduino analogRead() returns a 10-bit value by default, but the
+  // resolution can be changed with setAnalogResolution().
+  _maxValue = ((1UL << _analogResolution) - 1) << _oversampling;
+  _calibrationCombined.initialized = false; // depends on _maxValue
+  _offValuesValid = false;
 }
 
 void QTRSensors::setSensorPins(const uint8_t * pins, uint8_t sensorCount)
 {
   if (sensorCount > QTRMaxSensors) { sensorCount = QTRMaxSensors; }
+  if ((_bufferCapacity != 0) && (sensorCount > _bufferCapacity))
+  {
+    sensorCount = _bufferCapacity;
+  }
 
   // (Re)allocate and initialize the array if necessary.
-  uint8_t * oldSensorPins = _sensorPins;
-  _sensorPins = (uint8_t *)realloc(_sensorPins, sizeof(uint8_t) * sensorCount);
-  if (_sensorPins == nullptr)
+  if (!allocateArray(_sensorPins, sensorCount))
   {
     // Memory allocation failed; don't continue.
-    free(oldSensorPins); // deallocate any memory used by old array
     return;
   }
 
@@ -32,25 +123,212 @@ void QTRSensors::setSensorPins(const uint8_t * pins, uint8_t sensorCount)
     _sensorPins[i] = pins[i];
   }
 
+  sensorPinsChanged(sensorCount);
+}
+
+void QTRSensors::useBuffer(uint8_t * pins, SensorBit * sensorBits,
+                           SensorPort * sensorPorts, uint16_t * calibration,
+                           uint16_t * calibrationCombined,
+                           CalibrationScales * calibrationScales,
+                           uint16_t * offValues, uint32_t * analogSums,
+                           SampleSet * sampleSets, uint8_t capacity)
+{
+  // Keep any pins that were already set.
+  uint8_t sensorCount = (_sensorCount < capacity) ? _sensorCount : capacity;
+  if (_sensorPins != nullptr)
+  {
+    for (uint8_t i = 0; i < sensorCount; i++)
+    {
+      pins[i] = _sensorPins[i];
+    }
+  }
+  else
+  {
+    sensorCount = 0;
+  }
+
+  if (_bufferCapacity == 0) { freeArrays(); }
+
+  _sensorPins = pins;
+  _sensorBits = sensorBits;
+  _sensorPorts = sensorPorts;
+
+  if (calibration != nullptr)
+  {
+    calibrationOn.minimum = calibration;
+    calibrationOn.maximum = calibration + capacity;
+    calibrationOff.minimum = calibration + capacity * 2;
+    calibrationOff.maximum = calibration + capacity * 3;
+    _calibrationScratch = calibration + capacity * 4;
+  }
+  else
+  {
+    calibrationOn.minimum = calibrationOn.maximum = nullptr;
+    calibrationOff.minimum = calibrationOff.maximum = nullptr;
+    _calibrationScratch = nullptr;
+  }
+
+  if (calibrationCombined != nullptr)
+  {
+    _calibrationCombined.minimum = calibrationCombined;
+    _calibrationCombined.maximum = calibrationCombined + capacity;
+  }
+  else
+  {
+    _calibrationCombined.minimum = _calibrationCombined.maximum = nullptr;
+  }
+
+  _calibrationScales = calibrationScales;
+  _offValues = offValues;
+  _analogSums = analogSums;
+  _sampleSets = sampleSets;
+  _bufferCapacity = capacity;
+
+  sensorPinsChanged(sensorCount);
+}
+
+// Frees the arrays allocated on the heap (if no buffer has been set).
+void QTRSensors::freeArrays()
+{
+  if (_bufferCapacity != 0) { return; }
+
+  free(_sensorPins);
+  free(_sensorBits);
+  free(_sensorPorts);
+  free(_offValues);
+  free(_analogSums);
+  free(_sampleSets);
+  free(_calibrationScales);
+  free(calibrationOn.maximum);
+  free(calibrationOff.maximum);
+  free(calibrationOn.minimum);
+  free(calibrationOff.minimum);
+  free(_calibrationCombined.maximum);
+  free(_calibrationCombined.minimum);
+}
+
+// Updates everything that depends on the sensor pins after they change.
+void QTRSensors::sensorPinsChanged(uint8_t sensorCount)
+{
+  stopScan();
+
   _sensorCount = sensorCount;
 
+  groupSensorPorts();
+
+  // The calibration multipliers and combined on/off calibration need to be
+  // reallocated and recomputed.
+  _calibrationScalesInitialized = false;
+  _calibrationCombined.initialized = false;
+
+  // Abandon any read started with startRead(), and resize the stored off
+  // values if they have been allocated.
+  _readState = ReadState::Idle;
+  if (_offValues != nullptr) { allocateArray(_offValues, sensorCount); }
+  _offValuesValid = false;
+
+  // The arrays used by analog reads are reallocated when they are next
+  // needed.
+  if (_bufferCapacity == 0)
+  {
+    free(_analogSums);
+    _analogSums = nullptr;
+    free(_sampleSets);
+    _sampleSets = nullptr;
+  }
+
   // Any previous calibration values are no longer valid, and the calibration
   // arrays might need to be reallocated if the sensor count was changed.
   calibrationOn.initialized = false;
   calibrationOff.initialized = false;
 }
 
+void QTRSensors::groupSensorPorts()
+{
+  _sensorPortCount = 0;
+
+#if QTR_PORT_POLLING
+  if (!allocateArray(_sensorBits, _sensorCount) ||
+      !allocateArray(_sensorPorts, _sensorCount))
+  {
+    // Memory allocation failed; readPrivate() will fall back to digitalRead().
+    return;
+  }
+
+  uint8_t portCount = 0;
+
+  for (uint8_t i = 0; i < _sensorCount; i++)
+  {
+    const volatile PortMask * input =
+      (const volatile PortMask *)portInputRegister(digitalPinToPort(_sensorPins[i]));
+    if (input == nullptr) { return; } // not a valid pin
+
+    // find the port this pin belongs to, or add it if it is new
+    uint8_t port = 0;
+    while ((port < portCount) && (_sensorPorts[port].input != input)) { port++; }
+    if (port == portCount)
+    {
+      _sensorPorts[port].input = input;
+      portCount++;
+    }
+
+    _sensorBits[i].port = port;
+    _sensorBits[i].mask = digitalPinToBitMask(_sensorPins[i]);
+  }
+
+  _sensorPortCount = portCount;
+#endif
+}
+
 void QTRSensors::setTimeout(uint16_t timeout)
 {
   if (timeout > 32767) { timeout = 32767; }
   _timeout = timeout;
   if (_type == QTRType::RC) { _maxValue = timeout; }
+  _calibrationCombined.initialized = false; // depends on _maxValue
+  _offValuesValid = false;
 }
 
 void QTRSensors::setSamplesPerSensor(uint8_t samples)
 {
-  if (samples > 64) { samples = 64; }
+  if (samples == 0) { samples = 1; }
   _samplesPerSensor = samples;
+  _offValuesValid = false;
+}
+
+void QTRSensors::setAnalogResolution(uint8_t bits)
+{
+  if (bits < 1) { bits = 1; }
+  if (bits > 16) { bits = 16; }
+  _analogResolution = bits;
+  if (_oversampling > 16 - bits) { _oversampling = 16 - bits; }
+  analogScaleChanged();
+}
+
+void QTRSensors::setOversampling(uint8_t extraBits)
+{
+  if (extraBits > 4) { extraBits = 4; }
+  if (extraBits > 16 - _analogResolution) { extraBits = 16 - _analogResolution; }
+  _oversampling = extraBits;
+  analogScaleChanged();
+}
+
+// Updates everything that depends on the range of the analog readings after
+// it changes.
+void QTRSensors::analogScaleChanged()
+{
+  if (_type == QTRType::Analog) { setTypeAnalog(); }
+
+  // Calibration values taken with a different range are no longer valid.
+  calibrationOn.initialized = false;
+  calibrationOff.initialized = false;
+}
+
+void QTRSensors::setOffRefreshInterval(uint8_t interval)
+{
+  if (interval == 0) { interval = 1; }
+  _offRefreshInterval = interval;
+  _offValuesValid = false;
 }
 
 void QTRSensors::setEmitterPin(uint8_t emitterPin)
@@ -61,6 +339,7 @@ void QTRSensors::setEmitterPin(uint8_t emitterPin)
   pinMode(_oddEmitterPin, OUTPUT);
 
   _emitterPinCount = 1;
+  syncEmitterState();
 }
 
 void QTRSensors::setEmitterPins(uint8_t oddEmitterPin, uint8_t evenEmitterPin)
@@ -73,6 +352,7 @@ void QTRSensors::setEmitterPins(uint8_t oddEmitterPin, uint8_t evenEmitterPin)
   pinMode(_evenEmitterPin, OUTPUT);
 
   _emitterPinCount = 2;
+  syncEmitterState();
 }
 
 void QTRSensors::releaseEmitterPins()
@@ -90,6 +370,16 @@ void QTRSensors::releaseEmitterPins()
   }
 
   _emitterPinCount = 0;
+  _oddEmitterOn = false;
+  _evenEmitterOn = false;
+}
+
+void QTRSensors::syncEmitterState()
+{
+  _oddEmitterOn = (_oddEmitterPin != QTRNoEmitterPin) &&
+    (digitalRead(_oddEmitterPin) == HIGH);
+  _evenEmitterOn = (_evenEmitterPin != QTRNoEmitterPin) &&
+    (digitalRead(_evenEmitterPin) == HIGH);
 }
 
 void QTRSensors::setDimmingLevel(uint8_t dimmingLevel)
@@ -101,6 +391,7 @@ void QTRSensors::setDimmingLevel(uint8_t dimmingLevel)
 // emitters defaults to QTREmitters::All; wait defaults to true
 void QTRSensors::emittersOff(QTREmitters emitters, bool wait)
 {
+  QTR_TIME_PHASE(QTRPhase::EmittersOff);
   bool pinChanged = false;
 
   // Use odd emitter pin in these cases:
@@ -111,10 +402,10 @@ void QTRSensors::emittersOff(QTREmitters emitters, bool wait)
       (_emitterPinCount == 2 && emitters == QTREmitters::Odd))
   {
     // Check if pin is defined and only turn off if not already off
-    if ((_oddEmitterPin != QTRNoEmitterPin) &&
-        (digitalRead(_oddEmitterPin) == HIGH))
+    if ((_oddEmitterPin != QTRNoEmitterPin) && _oddEmitterOn)
     {
       digitalWrite(_oddEmitterPin, LOW);
+      _oddEmitterOn = false;
       pinChanged = true;
     }
   }
@@ -126,30 +417,34 @@ void QTRSensors::emittersOff(QTREmitters emitters, bool wait)
       (emitters == QTREmitters::All || emitters == QTREmitters::Even))
   {
     // Check if pin is defined and only turn off if not already off
-    if ((_evenEmitterPin != QTRNoEmitterPin) &&
-        (digitalRead(_evenEmitterPin) == HIGH))
+    if ((_evenEmitterPin != QTRNoEmitterPin) && _evenEmitterOn)
     {
       digitalWrite(_evenEmitterPin, LOW);
+      _evenEmitterOn = false;
       pinChanged = true;
     }
   }
 
-  if (wait && pinChanged)
+  if (pinChanged)
   {
-    if (_dimmable)
-    {
-      // driver min is 1 ms
-      delayMicroseconds(1200);
-    }
-    else
+    addEmitterSettleTime(micros(), _dimmable ? 1200 : 200);
+  }
+
+  if (wait)
+  {
+    // Wait until the emitters have had time to turn off (driver min is 1 ms
+    // for dimmable sensors). This includes emitters that were turned off
+    // earlier without waiting, such as at the end of an off-first read.
+    while (!emittersSettled())
     {
-      delayMicroseconds(200);
+      delayMicroseconds(10);
     }
   }
 }
 
 void QTRSensors::emittersOn(QTREmitters emitters, bool wait)
 {
+  QTR_TIME_PHASE(QTRPhase::EmittersOn);
   bool pinChanged = false;
   uint16_t emittersOnStart;
 
@@ -163,11 +458,11 @@ void QTRSensors::emittersOn(QTREmitters emitters, bool wait)
     // Check if pin is defined, and only turn on non-dimmable sensors if not
     // already on, but always turn dimmable sensors off and back on because
     // we might be changing the dimming level (emittersOnWithPin() should take
-    // care of this)
+    // care of this), except during an emitter session
     if ((_oddEmitterPin != QTRNoEmitterPin) &&
-        ( _dimmable || (digitalRead(_oddEmitterPin) == LOW)))
+        ((_dimmable && !_emitterSession) || !_oddEmitterOn))
     {
-      emittersOnStart = emittersOnWithPin(_oddEmitterPin);
+      emittersOnStart = emittersOnWithPin(_oddEmitterPin, _oddEmitterOn);
       pinChanged = true;
     }
   }
@@ -181,15 +476,27 @@ void QTRSensors::emittersOn(QTREmitters emitters, bool wait)
     // Check if pin is defined, and only turn on non-dimmable sensors if not
     // already on, but always turn dimmable sensors off and back on because
     // we might be changing the dimming level (emittersOnWithPin() should take
-    // care of this)
+    // care of this), except during an emitter session
     if ((_evenEmitterPin != QTRNoEmitterPin) &&
-        (_dimmable || (digitalRead(_evenEmitterPin) == LOW)))
+        ((_dimmable && !_emitterSession) || !_evenEmitterOn))
     {
-      emittersOnStart = emittersOnWithPin(_evenEmitterPin);
+      emittersOnStart = emittersOnWithPin(_evenEmitterPin, _evenEmitterOn);
       pinChanged = true;
     }
   }
 
+  if (pinChanged)
+  {
+    if (_dimmable)
+    {
+      addEmitterSettleTime(emittersOnStart, 300);
+    }
+    else
+    {
+      addEmitterSettleTime(micros(), 200);
+    }
+  }
+
   if (wait && pinChanged)
   {
     if (_dimmable)
@@ -210,10 +517,11 @@ void QTRSensors::emittersOn(QTREmitters emitters, bool wait)
 }
 
 // assumes pin is valid (not QTRNoEmitterPin)
+// pinOn is the tracked state of the pin, which this function sets to true
 // returns time when pin was first set high (used by emittersSelect())
-uint16_t QTRSensors::emittersOnWithPin(uint8_t pin)
+uint16_t QTRSensors::emittersOnWithPin(uint8_t pin, bool & pinOn)
 {
-  if (_dimmable && (digitalRead(pin) == HIGH))
+  if (_dimmable && pinOn)
   {
     // We are turning on dimmable emitters that are already on. To avoid messing
     // up the dimming level, we have to turn the emitters off and back on. This
@@ -224,26 +532,79 @@ uint16_t QTRSensors::emittersOnWithPin(uint8_t pin)
   }
 
   digitalWrite(pin, HIGH);
+  pinOn = true;
   uint16_t emittersOnStart = micros();
 
   if (_dimmable && (_dimmingLevel > 0))
   {
-    noInterrupts();
-
-    for (uint8_t i = 0; i < _dimmingLevel; i++)
+    if (_dimmer != nullptr)
     {
-      delayMicroseconds(1);
-      digitalWrite(pin, LOW);
-      delayMicroseconds(1);
-      digitalWrite(pin, HIGH);
+      _dimmer->sendPulses(pin, _dimmingLevel);
+    }
+    else
+    {
+      sendDimmingPulses(pin);
     }
-
-    interrupts();
   }
 
   return emittersOnStart;
 }
 
+// Sends _dimmingLevel pulses to the emitter control pin in software. Only the
+// low part of each pulse has to be kept short (an interrupt there could make
+// the driver turn the emitters off), so interrupts are only disabled during
+// that part instead of for the whole pulse train.
+void QTRSensors::sendDimmingPulses(uint8_t pin)
+{
+#if defined(__AVR__)
+  volatile uint8_t * out = portOutputRegister(digitalPinToPort(pin));
+  uint8_t mask = digitalPinToBitMask(pin);
+#endif
+
+  for (uint8_t i = 0; i < _dimmingLevel; i++)
+  {
+    delayMicroseconds(1);
+
+    InterruptState state = disableInterrupts();
+#if defined(__AVR__)
+    *out &= ~mask;
+    delayMicroseconds(1);
+    *out |= mask;
+#else
+    digitalWrite(pin, LOW);
+    delayMicroseconds(1);
+    digitalWrite(pin, HIGH);
+#endif
+    restoreInterrupts(state);
+  }
+}
+
+// Records that the emitters need [time] microseconds from [start] to reach
+// their new state, unless emitters changed earlier need longer than that.
+void QTRSensors::addEmitterSettleTime(uint16_t start, uint16_t time)
+{
+  uint32_t now = micros();
+  uint16_t elapsed = (uint16_t)now - start;
+  uint16_t remaining = (elapsed < time) ? (time - elapsed) : 0;
+
+  // The start time is kept as a full 32-bit micros() value so that the
+  // emitters are not mistaken for unsettled after a long idle period.
+  uint32_t oldElapsed = now - _emitterSettleStart;
+  uint16_t oldRemaining = (oldElapsed < _emitterSettleTime) ?
+    (_emitterSettleTime - oldElapsed) : 0;
+
+  if (remaining >= oldRemaining)
+  {
+    _emitterSettleStart = now - elapsed;
+    _emitterSettleTime = time;
+  }
+}
+
+bool QTRSensors::emittersSettled()
+{
+  return (micros() - _emitterSettleStart) >= _emitterSettleTime;
+}
+
 void QTRSensors::emittersSelect(QTREmitters emitters)
 {
   QTREmitters offEmitters;
@@ -290,6 +651,50 @@ void QTRSensors::emittersSelect(QTREmitters emitters)
   }
 }
 
+void QTRSensors::beginEmitterSession()
+{
+  // Turn the emitters on (reapplying the dimming level) before starting the
+  // session, so that this is the last time they are switched until it ends.
+  _emitterSession = false;
+  emittersOn();
+  _emitterSession = true;
+}
+
+void QTRSensors::endEmitterSession(bool wait)
+{
+  _emitterSession = false;
+  emittersOff(QTREmitters::All, wait);
+}
+
+#if QTR_TIMING_STATS
+void QTRSensors::resetPhaseStats()
+{
+  for (uint8_t i = 0; i < QTRPhaseCount; i++)
+  {
+    _phaseStats[i].count = 0;
+    _phaseStats[i].total = 0;
+  }
+}
+
+void QTRSensors::recordPhase(QTRPhase phase, uint16_t start)
+{
+  uint16_t time = micros() - start;
+  QTRPhaseStats & stats = _phaseStats[(uint8_t)phase];
+
+  if (stats.count == 0xFFFF) { return; }
+
+  if ((stats.count == 0) || (time < stats.minimum)) { stats.minimum = time; }
+  if ((stats.count == 0) || (time > stats.maximum)) { stats.maximum = time; }
+  stats.total += time;
+  stats.count++;
+}
+
+QTRSensors::PhaseTimer::PhaseTimer(QTRSensors & sensors, QTRPhase phase) :
+  _sensors(sensors), _phase(phase), _start(micros())
+{
+}
+#endif
+
 void QTRSensors::resetCalibration()
 {
   for (uint8_t i = 0; i < _sensorCount; i++)
@@ -299,6 +704,9 @@ void QTRSensors::resetCalibration()
     if (calibrationOn.minimum)   { calibrationOn.minimum[i] = _maxValue; }
     if (calibrationOff.minimum)  { calibrationOff.minimum[i] = _maxValue; }
   }
+
+  // the combined on/off calibration needs to be recomputed
+  _calibrationCombined.initialized = false;
 }
 
 void QTRSensors::calibrate(QTRReadMode mode)
@@ -327,30 +735,13 @@ void QTRSensors::calibrate(QTRReadMode mode)
 
 void QTRSensors::calibrateOnOrOff(CalibrationData & calibration, QTRReadMode mode)
 {
-  uint16_t sensorValues[QTRMaxSensors];
-  uint16_t maxSensorValues[QTRMaxSensors];
-  uint16_t minSensorValues[QTRMaxSensors];
-
   // (Re)allocate and initialize the arrays if necessary.
   if (!calibration.initialized)
   {
-    uint16_t * oldMaximum = calibration.maximum;
-    calibration.maximum = (uint16_t *)realloc(calibration.maximum,
-                                              sizeof(uint16_t) * _sensorCount);
-    if (calibration.maximum == nullptr)
-    {
-      // Memory allocation failed; don't continue.
-      free(oldMaximum); // deallocate any memory used by old array
-      return;
-    }
-
-    uint16_t * oldMinimum = calibration.minimum;
-    calibration.minimum = (uint16_t *)realloc(calibration.minimum,
-                                              sizeof(uint16_t) * _sensorCount);
-    if (calibration.minimum == nullptr)
+    if (!allocateArray(calibration.maximum, _sensorCount) ||
+        !allocateArray(calibration.minimum, _sensorCount))
     {
       // Memory allocation failed; don't continue.
-      free(oldMinimum); // deallocate any memory used by old array
       return;
     }
 
@@ -365,6 +756,23 @@ void QTRSensors::calibrateOnOrOff(CalibrationData & calibration, QTRReadMode mod
     calibration.initialized = true;
   }
 
+  // The readings and the range of readings found THIS time are kept in the
+  // buffer set with setBuffer(), or else in memory allocated just for this
+  // call, instead of on the stack. (The memory is allocated after the
+  // calibration arrays, so freeing it afterward does not fragment the heap.)
+  uint16_t * sensorValues = _calibrationScratch;
+  if (_bufferCapacity == 0)
+  {
+    sensorValues = (uint16_t *)malloc(sizeof(uint16_t) * 3 * _sensorCount);
+    if (sensorValues == nullptr)
+    {
+      // Memory allocation failed; don't continue.
+      return;
+    }
+  }
+  uint16_t * maxSensorValues = sensorValues + _sensorCount;
+  uint16_t * minSensorValues = sensorValues + _sensorCount * 2;
+
   for (uint8_t j = 0; j < 10; j++)
   {
     read(sensorValues, mode);
@@ -402,10 +810,42 @@ void QTRSensors::calibrateOnOrOff(CalibrationData & calibration, QTRReadMode mod
       calibration.minimum[i] = maxSensorValues[i];
     }
   }
+
+  if (_bufferCapacity == 0) { free(sensorValues); }
+
+  // the combined on/off calibration needs to be recomputed
+  _calibrationCombined.initialized = false;
 }
 
 void QTRSensors::read(uint16_t * sensorValues, QTRReadMode mode)
 {
+  QTR_TIME_PHASE(QTRPhase::Read);
+
+  bool andOff = (mode == QTRReadMode::OnAndOff ||
+                 mode == QTRReadMode::OddEvenAndOff);
+  bool readOff = false;
+
+  // Memory allocation failed; there is nowhere to take the off readings.
+  if (!allocateOffValues(mode)) { return; }
+
+  if (andOff)
+  {
+    // A masked read only takes off readings of the selected sensors, so it
+    // can't reuse the stored ones or leave them for the next read.
+    readOff = _readMasked || (_offRefreshInterval <= 1) || offValuesNeeded();
+  }
+
+  bool offFirst = readOff && _offFirst;
+
+  if (offFirst)
+  {
+    // Take the off readings while the emitters are still off from the
+    // previous read. emittersOff() only waits for whatever is left of their
+    // turn-off time.
+    emittersOff();
+    readPrivate(_offValues);
+  }
+
   switch (mode)
   {
     case QTRReadMode::Off:
@@ -417,134 +857,615 @@ void QTRSensors::read(uint16_t * sensorValues, QTRReadMode mode)
 
     case QTRReadMode::On:
     case QTRReadMode::OnAndOff:
-      emittersOn();
+      emittersOn(maskEmitters());
       readPrivate(sensorValues);
-      emittersOff();
+      // During an emitter session, leave the emitters on for the next read.
+      if (_emitterSession && (mode == QTRReadMode::On)) { break; }
+      // If nothing is read with the emitters off after this (because of
+      // off-first ordering or reused off readings), don't wait for them to
+      // turn off; the next read will if it needs to.
+      emittersOff(QTREmitters::All, !andOff || (readOff && !offFirst));
       break;
 
     case QTRReadMode::OddEven:
     case QTRReadMode::OddEvenAndOff:
-      // Turn on odd emitters and read the odd-numbered sensors.
+      // Turn on odd emitters and read the odd-numbered sensors (unless a
+      // masked read leaves them all out).
       // (readPrivate takes a 0-based array index, so start = 0 to start with
       // the first sensor)
-      emittersSelect(QTREmitters::Odd);
-      readPrivate(sensorValues, 0, 2);
+      if (!_readMasked || readSelects(0, 2))
+      {
+        emittersSelect(QTREmitters::Odd);
+        readPrivate(sensorValues, 0, 2);
+      }
 
-      // Turn on even emitters and read the even-numbered sensors.
+      // Turn on even emitters and read the even-numbered sensors (unless a
+      // masked read leaves them all out).
       // (readPrivate takes a 0-based array index, so start = 1 to start with
       // the second sensor)
-      emittersSelect(QTREmitters::Even);
-      readPrivate(sensorValues, 1, 2);
+      if (!_readMasked || readSelects(1, 2))
+      {
+        emittersSelect(QTREmitters::Even);
+        readPrivate(sensorValues, 1, 2);
+      }
 
-      emittersOff();
+      emittersOff(QTREmitters::All, !andOff || (readOff && !offFirst));
       break;
 
     default: // invalid - do nothing
       return;
   }
 
-  if (mode == QTRReadMode::OnAndOff ||
-      mode == QTRReadMode::OddEvenAndOff)
+  if (andOff)
   {
-    // Take a second set of readings and return the values (on + max - off).
+    // Take a second set of readings (unless they were taken first or are
+    // being reused) and return the values (on + max - off).
+    if (readOff && !offFirst) { readPrivate(_offValues); }
+    if (readOff) { _offValuesValid = !_readMasked; }
+    combineOffValues(sensorValues, _offValues);
+  }
+}
 
-    uint16_t offValues[QTRMaxSensors];
-    readPrivate(offValues);
+void QTRSensors::readMasked(uint16_t * sensorValues, const uint8_t * mask,
+                            QTRReadMode mode)
+{
+  if (beginMaskedRead(mask)) { read(sensorValues, mode); }
+  _readMasked = false;
+}
 
-    for (uint8_t i = 0; i < _sensorCount; i++)
-    {
-      sensorValues[i] += _maxValue - offValues[i];
-      if (sensorValues[i] > _maxValue)
-      {
-        // This usually doesn't happen, because the sensor reading should
-        // go up when the emitters are turned off.
-        sensorValues[i] = _maxValue;
-      }
-    }
-  }
+void QTRSensors::readCalibratedMasked(uint16_t * sensorValues,
+                                      const uint8_t * mask, QTRReadMode mode)
+{
+  if (beginMaskedRead(mask)) { readCalibrated(sensorValues, mode); }
+  _readMasked = false;
 }
 
-void QTRSensors::readCalibrated(uint16_t * sensorValues, QTRReadMode mode)
+// Sets up the mask used by the following read (until _readMasked is cleared).
+// The mask is not copied, so it must stay valid until then. Returns false if
+// it does not select any sensors.
+bool QTRSensors::beginMaskedRead(const uint8_t * mask)
 {
-  // manual emitter control is not supported
-  if (mode == QTRReadMode::Manual) { return; }
+  _readMask = mask;
+  _readMasked = true;
+  useScan();
+  return readSelects(0, 1);
+}
 
-  // if not calibrated, do nothing
+// Returns whether the read in progress includes any of the first of every
+// [step] sensors, starting with [start].
+bool QTRSensors::readSelects(uint8_t start, uint8_t step)
+{
+  for (uint8_t i = start; i < _sensorCount; i += step)
+  {
+    if (readIncludes(i)) { return true; }
+  }
+  return false;
+}
 
-  if (mode == QTRReadMode::On ||
-      mode == QTRReadMode::OnAndOff ||
-      mode == QTRReadMode::OddEvenAndOff)
+// Returns the emitters needed for the sensors selected by a masked read: with
+// separate odd and even emitter control pins, the sensors of one parity only
+// need one set of emitters.
+QTREmitters QTRSensors::maskEmitters()
+{
+  if (_readMasked && (_emitterPinCount == 2))
   {
-    if (!calibrationOn.initialized)
-    {
-      return;
-    }
+    if (!readSelects(1, 2)) { return QTREmitters::Odd; }
+    if (!readSelects(0, 2)) { return QTREmitters::Even; }
   }
+  return QTREmitters::All;
+}
 
-  if (mode == QTRReadMode::Off ||
-      mode == QTRReadMode::OnAndOff ||
-      mode == QTRReadMode::OddEvenAndOff)
+// Returns whether a read in [mode] has somewhere to keep its off readings:
+// reads in the OnAndOff and OddEvenAndOff modes keep them in _offValues
+// (instead of on the stack, so that they can be reused by the following reads
+// and the stack use does not depend on QTRMaxSensors), which this allocates
+// if needed.
+bool QTRSensors::allocateOffValues(QTRReadMode mode)
+{
+  if (mode != QTRReadMode::OnAndOff && mode != QTRReadMode::OddEvenAndOff)
   {
-    if (!calibrationOff.initialized)
-    {
-      return;
-    }
+    return true;
+  }
+  return (_offValues != nullptr) || allocateArray(_offValues, _sensorCount);
+}
+
+// Returns whether a read in the OnAndOff or OddEvenAndOff mode should take new
+// off readings, or reuse the ones stored in _offValues (see
+// setOffRefreshInterval()), and counts the read toward the refresh interval.
+bool QTRSensors::offValuesNeeded()
+{
+  if (!_offValuesValid || (++_offValuesAge >= _offRefreshInterval))
+  {
+    // The stored values are invalid until the new ones have all been taken.
+    _offValuesValid = false;
+    _offValuesAge = 0;
+    return true;
   }
+  return false;
+}
+
+void QTRSensors::readCalibrated(uint16_t * sensorValues, QTRReadMode mode)
+{
+  // if not calibrated, or there is nowhere to take the off readings, do
+  // nothing
+  if (!isCalibrated(mode) || !allocateOffValues(mode)) { return; }
 
   // read the needed values
   read(sensorValues, mode);
 
-  for (uint8_t i = 0; i < _sensorCount; i++)
-  {
-    uint16_t calmin, calmax;
+  applyCalibration(sensorValues, mode);
+}
 
-    // find the correct calibration
-    if (mode == QTRReadMode::On ||
-        mode == QTRReadMode::OddEven)
-    {
-      calmax = calibrationOn.maximum[i];
-      calmin = calibrationOn.minimum[i];
-    }
-    else if (mode == QTRReadMode::Off)
-    {
-      calmax = calibrationOff.maximum[i];
-      calmin = calibrationOff.minimum[i];
-    }
-    else // QTRReadMode::OnAndOff, QTRReadMode::OddEvenAndOff
-    {
-      if (calibrationOff.minimum[i] < calibrationOn.minimum[i])
-      {
-        // no meaningful signal
-        calmin = _maxValue;
-      }
-      else
-      {
-        // this won't go past _maxValue
-        calmin = calibrationOn.minimum[i] + _maxValue - calibrationOff.minimum[i];
-      }
+bool QTRSensors::startRead(uint16_t * sensorValues, QTRReadMode mode)
+{
+  cancelRead();
+  return startReadPrivate(sensorValues, mode, false);
+}
 
-      if (calibrationOff.maximum[i] < calibrationOn.maximum[i])
-      {
-        // no meaningful signal
-        calmax = _maxValue;
-      }
-      else
+bool QTRSensors::startReadCalibrated(uint16_t * sensorValues, QTRReadMode mode)
+{
+  cancelRead();
+  return startReadPrivate(sensorValues, mode, true);
+}
+
+bool QTRSensors::startReadMasked(uint16_t * sensorValues,
+                                 const uint8_t * mask, QTRReadMode mode)
+{
+  cancelRead();
+  beginMaskedRead(mask);
+  return startReadPrivate(sensorValues, mode, false);
+}
+
+bool QTRSensors::startReadCalibratedMasked(uint16_t * sensorValues,
+                                           const uint8_t * mask,
+                                           QTRReadMode mode)
+{
+  cancelRead();
+  beginMaskedRead(mask);
+  return startReadPrivate(sensorValues, mode, true);
+}
+
+// Starts a read with the mask (if any) set up by the caller. The caller first
+// ends any read that is still in progress with cancelRead(), so that its
+// charging lines and interrupts are released before its state is replaced.
+// The mask stays in effect until the read finishes or is abandoned.
+bool QTRSensors::startReadPrivate(uint16_t * sensorValues, QTRReadMode mode,
+                                  bool calibrated)
+{
+  _readValues = sensorValues;
+  _readMode = mode;
+  _readPass = 0;
+  _readCalibrated = calibrated;
+  _readOffFirst = _offFirst;
+  _readOffValues = false;
+  _readState = ReadState::Failed;
+
+  // If the mask does not select any sensors or the sensors are not
+  // calibrated (like readCalibrated()), do nothing.
+  if ((_readMasked && !readSelects(0, 1)) ||
+      (calibrated && !isCalibrated(mode)))
+  {
+    _readMasked = false;
+    return false;
+  }
+
+  // The off readings have to be kept until the read finishes.
+  if (!allocateOffValues(mode))
+  {
+    // Memory allocation failed; don't continue.
+    _readMasked = false;
+    return false;
+  }
+
+  if (mode == QTRReadMode::OnAndOff ||
+      mode == QTRReadMode::OddEvenAndOff)
+  {
+    // A masked read only takes off readings of the selected sensors, so it
+    // can't reuse the stored ones or leave them for the next read.
+    if (_readMasked)
+    {
+      _readOffValues = true;
+      _offValuesValid = false;
+    }
+    else
+    {
+      _readOffValues = (_offRefreshInterval <= 1) || offValuesNeeded();
+    }
+  }
+
+  _readState = ReadState::Emitters;
+  return true;
+}
+
+bool QTRSensors::poll()
+{
+  ReadPass pass;
+
+  while (true)
+  {
+    switch (_readState)
+    {
+      case ReadState::Emitters:
+        if (!getReadPass(_readMode, _readOffFirst, _readOffValues, _readPass, pass))
+        {
+          // all passes are done
+          if (_readMode == QTRReadMode::OnAndOff ||
+              _readMode == QTRReadMode::OddEvenAndOff)
+          {
+            if (_readOffValues && !_readMasked) { _offValuesValid = true; }
+            combineOffValues(_readValues, _offValues);
+          }
+          if (_readCalibrated)
+          {
+            applyCalibration(_readValues, _readMode);
+          }
+          _readMasked = false;
+          _readState = ReadState::Done;
+          return true;
+        }
+
+        // Switch the emitters without waiting; the settling time is tracked
+        // instead.
+        switch (pass.emitters)
+        {
+          case QTREmitters::All:
+            emittersOn(QTREmitters::All, false);
+            break;
+
+          case QTREmitters::Odd:
+            emittersOff(QTREmitters::Even, false);
+            emittersOn(QTREmitters::Odd, false);
+            break;
+
+          case QTREmitters::Even:
+            emittersOff(QTREmitters::Odd, false);
+            emittersOn(QTREmitters::Even, false);
+            break;
+
+          default: // QTREmitters::None
+            if (pass.controlEmitters) { emittersOff(QTREmitters::All, false); }
+            break;
+        }
+
+        _readState = ReadState::Settling;
+        // fall through
+
+      case ReadState::Settling:
+        getReadPass(_readMode, _readOffFirst, _readOffValues, _readPass, pass);
+
+        if (pass.controlEmitters && pass.settle && !emittersSettled())
+        {
+          return false;
+        }
+
+        if (pass.step == 0)
+        {
+          // nothing to read in this pass
+          _readPass++;
+          _readState = ReadState::Emitters;
+          continue;
+        }
+
+        if (!startScan(pass.off ? _offValues : _readValues,
+                       pass.start, pass.step))
+        {
+          // there is nothing to read
+          _readMasked = false;
+          _readState = ReadState::Failed;
+          return true;
+        }
+
+        _readState = ReadState::Scanning;
+        // fall through
+
+      case ReadState::Scanning:
+        if (!continueScan()) { return false; }
+
+        _readPass++;
+        _readState = ReadState::Emitters;
+        continue;
+
+      default: // ReadState::Idle, ReadState::Done, ReadState::Failed
+        return (_readState != ReadState::Idle);
+    }
+  }
+}
+
+void QTRSensors::cancelRead()
+{
+  if ((_readState == ReadState::Scanning) && (_type == QTRType::RC) &&
+      !_scanDischarging)
+  {
+    // stop driving the lines that are being charged
+    for (uint8_t i = _scanStart; i < _sensorCount; i = nextScanSensor(i))
+    {
+      pinMode(_sensorPins[i], INPUT);
+    }
+  }
+
+  stopScan();
+  _readMasked = false;
+  _readState = ReadState::Idle;
+}
+
+// Describes pass number [pass] of a read with the given mode and ordering
+// (see setOffFirst()), which takes new off readings if readOff is true: the
+// emitters it needs and the sensors it reads (step = 0 if it does not read
+// any). These are the same steps that read() takes. Returns false if there is
+// no such pass.
+bool QTRSensors::getReadPass(QTRReadMode mode, bool offFirst, bool readOff,
+                             uint8_t pass, ReadPass & readPass)
+{
+  bool andOff = (mode == QTRReadMode::OnAndOff ||
+                 mode == QTRReadMode::OddEvenAndOff);
+  readOff = readOff && andOff;
+  offFirst = offFirst && readOff;
+
+  readPass.emitters = QTREmitters::None;
+  readPass.controlEmitters = true;
+  readPass.settle = true;
+  readPass.start = 0;
+  readPass.step = 1;
+  readPass.off = false;
+
+  if (offFirst)
+  {
+    // Take the off readings first, then continue as usual.
+    if (pass == 0)
+    {
+      readPass.off = true;
+      return true;
+    }
+    pass--;
+  }
+
+  switch (mode)
+  {
+    case QTRReadMode::Off:
+    case QTRReadMode::Manual:
+      readPass.controlEmitters = (mode == QTRReadMode::Off);
+      return (pass == 0);
+
+    case QTRReadMode::On:
+    case QTRReadMode::OnAndOff:
+      if (pass == 0)
+      {
+        readPass.emitters = maskEmitters();
+        return true;
+      }
+      // During an emitter session, leave the emitters on for the next read.
+      if ((mode == QTRReadMode::On) && _emitterSession) { return false; }
+      break;
+
+    case QTRReadMode::OddEven:
+    case QTRReadMode::OddEvenAndOff:
+      if (pass < 2)
       {
-        // this won't go past _maxValue
-        calmax = calibrationOn.maximum[i] + _maxValue - calibrationOff.maximum[i];
+        // read the odd-numbered sensors, then the even-numbered sensors
+        readPass.emitters = (pass == 0) ? QTREmitters::Odd : QTREmitters::Even;
+        readPass.start = pass;
+        readPass.step = 2;
+
+        // skip the pass if a masked read leaves all of its sensors out
+        if (_readMasked && !readSelects(pass, 2))
+        {
+          readPass.emitters = QTREmitters::None;
+          readPass.controlEmitters = false;
+          readPass.step = 0;
+        }
+        return true;
       }
+      pass--;
+      break;
+
+    default: // invalid
+      return false;
+  }
+
+  if (pass != 1) { return false; }
+
+  // Turn the emitters off, then take the off readings if needed. If they
+  // were taken first or are being reused, there's no need to wait for the
+  // emitters to turn off.
+  readPass.off = readOff && !offFirst;
+  readPass.settle = !andOff || readPass.off;
+  if (!readPass.off) { readPass.step = 0; }
+  return true;
+}
+
+bool QTRSensors::isCalibrated(QTRReadMode mode)
+{
+  // manual emitter control is not supported
+  if (mode == QTRReadMode::Manual) { return false; }
+
+  if (mode == QTRReadMode::On ||
+      mode == QTRReadMode::OnAndOff ||
+      mode == QTRReadMode::OddEvenAndOff)
+  {
+    if (!calibrationOn.initialized)
+    {
+      return false;
     }
+  }
 
-    uint16_t denominator = calmax - calmin;
-    int16_t value = 0;
+  if (mode == QTRReadMode::Off ||
+      mode == QTRReadMode::OnAndOff ||
+      mode == QTRReadMode::OddEvenAndOff)
+  {
+    if (!calibrationOff.initialized)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Computes (on + max - off) for each sensor from the on readings in
+// sensorValues and the off readings in offValues.
+void QTRSensors::combineOffValues(uint16_t * sensorValues, const uint16_t * offValues)
+{
+  for (uint8_t i = 0; i < _sensorCount; i++)
+  {
+    // leave the sensors left out of a masked read alone
+    if (!readIncludes(i)) { continue; }
+
+    // This is sensorValues[i] + _maxValue - offValues[i], computed so that
+    // it can't overflow when _maxValue uses all 16 bits.
+    if (sensorValues[i] >= offValues[i])
+    {
+      // This usually doesn't happen, because the sensor reading should
+      // go up when the emitters are turned off.
+      sensorValues[i] = _maxValue;
+    }
+    else
+    {
+      sensorValues[i] = _maxValue - (offValues[i] - sensorValues[i]);
+    }
+  }
+}
+
+// Gets the calibration bounds for sensor [i] in the OnAndOff and OddEvenAndOff
+// modes, which are derived from both the on and off calibration.
+void QTRSensors::getCombinedCalibration(uint8_t i, uint16_t & calmin, uint16_t & calmax)
+{
+  if (calibrationOff.minimum[i] < calibrationOn.minimum[i])
+  {
+    // no meaningful signal
+    calmin = _maxValue;
+  }
+  else
+  {
+    // this won't go past _maxValue
+    calmin = _maxValue - (calibrationOff.minimum[i] - calibrationOn.minimum[i]);
+  }
+
+  if (calibrationOff.maximum[i] < calibrationOn.maximum[i])
+  {
+    // no meaningful signal
+    calmax = _maxValue;
+  }
+  else
+  {
+    // this won't go past _maxValue
+    calmax = _maxValue - (calibrationOff.maximum[i] - calibrationOn.maximum[i]);
+  }
+}
+
+// Computes the combined on/off calibration bounds for all sensors so that
+// readCalibrated() does not have to do it for every reading. They stay valid
+// until the calibration changes (see invalidateCalibrationCache()).
+void QTRSensors::updateCombinedCalibration()
+{
+  if (!allocateArray(_calibrationCombined.maximum, _sensorCount) ||
+      !allocateArray(_calibrationCombined.minimum, _sensorCount))
+  {
+    // Memory allocation failed; the bounds will be computed as needed.
+    return;
+  }
+
+  for (uint8_t i = 0; i < _sensorCount; i++)
+  {
+    getCombinedCalibration(i, _calibrationCombined.minimum[i],
+                           _calibrationCombined.maximum[i]);
+  }
+
+  _calibrationCombined.initialized = true;
+}
+
+// Converts raw readings taken with the given mode to calibrated values.
+void QTRSensors::applyCalibration(uint16_t * sensorValues, QTRReadMode mode)
+{
+  QTR_TIME_PHASE(QTRPhase::Calibration);
+
+  // Get the multipliers used instead of dividing by the calibration range,
+  // (re)allocating them if necessary. If that fails, fall back to dividing.
+  if (!_calibrationScalesInitialized &&
+      allocateArray(_calibrationScales, _sensorCount))
+  {
+    for (uint8_t i = 0; i < _sensorCount; i++)
+    {
+      // a denominator of 0 is never looked up, so this marks the entry empty
+      for (uint8_t c = 0; c < 3; c++)
+      {
+        _calibrationScales[i].calibration[c].denominator = 0;
+      }
+    }
+    _calibrationScalesInitialized = true;
+  }
+  CalibrationScales * scales =
+    _calibrationScalesInitialized ? _calibrationScales : nullptr;
+
+  // find the correct calibration, and the multipliers cached for it
+  CalibrationData * calibration;
+  uint8_t calibrationIndex;
+  if (mode == QTRReadMode::On ||
+      mode == QTRReadMode::OddEven)
+  {
+    calibration = &calibrationOn;
+    calibrationIndex = 0;
+  }
+  else if (mode == QTRReadMode::Off)
+  {
+    calibration = &calibrationOff;
+    calibrationIndex = 1;
+  }
+  else // QTRReadMode::OnAndOff, QTRReadMode::OddEvenAndOff
+  {
+    if (!_calibrationCombined.initialized) { updateCombinedCalibration(); }
+
+    // If the combined calibration could not be allocated, it is computed
+    // for each sensor below.
+    calibration = _calibrationCombined.initialized ? &_calibrationCombined : nullptr;
+    calibrationIndex = 2;
+  }
+
+  for (uint8_t i = 0; i < _sensorCount; i++)
+  {
+    // leave the sensors left out of a masked read alone
+    if (!readIncludes(i)) { continue; }
 
-    if (denominator != 0)
+    uint16_t calmin, calmax;
+    if (calibration != nullptr)
+    {
+      calmax = calibration->maximum[i];
+      calmin = calibration->minimum[i];
+    }
+    else
     {
-      value = (((int32_t)sensorValues[i]) - calmin) * 1000 / denominator;
+      getCombinedCalibration(i, calmin, calmax);
     }
 
-    if (value < 0) { value = 0; }
-    else if (value > 1000) { value = 1000; }
+    uint16_t denominator = calmax - calmin;
+    uint16_t value = 0;
+
+    if ((denominator != 0) && (sensorValues[i] > calmin))
+    {
+      uint16_t difference = sensorValues[i] - calmin;
+
+      if (difference >= denominator)
+      {
+        value = 1000;
+      }
+      else if (scales != nullptr)
+      {
+        // Compute difference * 1000 / denominator with a multiply and shift,
+        // using a multiplier that is recomputed only when the denominator
+        // changes. The result can be 1 higher than with the division.
+        CalibrationScale & scale = scales[i].calibration[calibrationIndex];
+        if (scale.denominator != denominator)
+        {
+          scale.denominator = denominator;
+          scale.multiplier = ((1000UL << 22) + denominator - 1) / denominator;
+        }
+        // (difference < denominator, so this can't overflow)
+        value = ((uint32_t)difference * scale.multiplier) >> 22;
+      }
+      else
+      {
+        value = (uint32_t)difference * 1000 / denominator;
+      }
+    }
 
     sensorValues[i] = value;
   }
@@ -558,113 +1479,1065 @@ void QTRSensors::readPrivate(uint16_t * sensorValues, uint8_t start, uint8_t ste
 {
   if (_sensorPins == nullptr) { return; }
 
+  // Masked reads and the settings that need interrupts or kept samples go
+  // through the scan (see useScan()).
+  if ((_scanReader != nullptr) && scanNeeded())
+  {
+    _scanReader(*this, sensorValues, start, step);
+    return;
+  }
+
   switch (_type)
   {
     case QTRType::RC:
       for (uint8_t i = start; i < _sensorCount; i += step)
       {
         sensorValues[i] = _maxValue;
+        if (_rcLines != nullptr) { continue; }
         // make sensor line an output (drives low briefly, but doesn't matter)
         pinMode(_sensorPins[i], OUTPUT);
         // drive sensor line high
         digitalWrite(_sensorPins[i], HIGH);
       }
 
-      delayMicroseconds(10); // charge lines for 10 us
+      if (_rcLines != nullptr)
+      {
+        // the port registers are changed with read-modify-write accesses
+        InterruptState state = disableInterrupts();
+        _rcLines(RCLineAction::Charge, sensorValues, 0, start, step);
+        restoreInterrupts(state);
+      }
+
+      {
+        QTR_TIME_PHASE(QTRPhase::Charge);
+        delayMicroseconds(10); // charge lines for 10 us
+      }
+
+      // mark the sensors being read as pending on their ports
+      for (uint8_t p = 0; p < _sensorPortCount; p++)
+      {
+        _sensorPorts[p].pending = 0;
+      }
+      if ((_sensorPortCount != 0) && (_rcLines == nullptr))
+      {
+        for (uint8_t i = start; i < _sensorCount; i += step)
+        {
+          _sensorPorts[_sensorBits[i].port].pending |= _sensorBits[i].mask;
+        }
+      }
 
       {
         // disable interrupts so we can switch all the pins as close to the same
         // time as possible
-        noInterrupts();
+        InterruptState state = disableInterrupts();
 
         // record start time before the first sensor is switched to input
         // (similarly, time is checked before the first sensor is read in the
         // loop below)
         uint32_t startTime = micros();
         uint16_t time = 0;
+        uint8_t pending = 0; // number of sensors that have not discharged yet
 
-        for (uint8_t i = start; i < _sensorCount; i += step)
+        if (_rcLines != nullptr)
         {
-          // make sensor line an input (should also ensure pull-up is disabled)
-          pinMode(_sensorPins[i], INPUT);
+          pending = _rcLines(RCLineAction::Release, sensorValues, 0, start, step);
+        }
+        else
+        {
+          for (uint8_t i = start; i < _sensorCount; i += step)
+          {
+            // make sensor line an input (should also ensure pull-up is disabled)
+            pinMode(_sensorPins[i], INPUT);
+            pending++;
+          }
         }
 
-        interrupts(); // re-enable
+        restoreInterrupts(state);
 
-        while (time < _maxValue)
+        // with early exit enabled, stop as soon as every sensor has discharged
+        while ((time < _maxValue) && (!_earlyExit || (pending != 0)))
         {
           // disable interrupts so we can read all the pins as close to the same
           // time as possible
-          noInterrupts();
+          state = disableInterrupts();
 
           time = micros() - startTime;
-          for (uint8_t i = start; i < _sensorCount; i += step)
+          if (time < _maxValue)
           {
-            if ((digitalRead(_sensorPins[i]) == LOW) && (time < sensorValues[i]))
+            if (_rcLines != nullptr)
             {
-              // record the first time the line reads low
-              sensorValues[i] = time;
+              pending -= _rcLines(RCLineAction::Poll, sensorValues, time, start, step);
+            }
+            else if (_sensorPortCount != 0)
+            {
+              pending -= pollSensorPorts(sensorValues, time, start, step);
+            }
+            else
+            {
+              for (uint8_t i = start; i < _sensorCount; i += step)
+              {
+                if ((digitalRead(_sensorPins[i]) == LOW) && (time < sensorValues[i]))
+                {
+                  // record the first time the line reads low
+                  sensorValues[i] = time;
+                  pending--;
+                }
+              }
             }
           }
 
-          interrupts(); // re-enable
+          restoreInterrupts(state);
         }
+
+        QTR_RECORD_PHASE(QTRPhase::Discharge, startTime);
       }
       return;
 
     case QTRType::Analog:
+    {
+      QTR_TIME_PHASE(QTRPhase::Analog);
+
+      // With oversampling, each sample is made up of 4^n conversions, and its
+      // sum is shifted right by n along with the averaging.
+      uint16_t conversions = (uint16_t)_samplesPerSensor << (2 * _oversampling);
+      uint16_t divisor = (uint16_t)_samplesPerSensor << _oversampling;
+
+      // The sums are kept in the values array, or in _analogSums if they (plus
+      // the rounding) might not fit in 16 bits. If _analogSums can't be used,
+      // each sensor's conversions are taken together and added up in [sum].
+      uint32_t * sums = nullptr;
+      if ((uint32_t)conversions * ((1UL << _analogResolution) - 1) +
+          (divisor >> 1) > 0xFFFF)
+      {
+        if ((_analogSums == nullptr) && !allocateArray(_analogSums, _sensorCount))
+        {
+          for (uint8_t i = start; i < _sensorCount; i += step)
+          {
+            uint32_t sum = 0;
+            for (uint16_t j = 0; j < conversions; j++)
+            {
+              sum += analogRead(_sensorPins[i]);
+            }
+            sensorValues[i] = (sum + (divisor >> 1)) / divisor;
+          }
+          return;
+        }
+        sums = _analogSums;
+      }
+
       // reset the values
       for (uint8_t i = start; i < _sensorCount; i += step)
       {
         sensorValues[i] = 0;
+        if (sums != nullptr) { sums[i] = 0; }
       }
 
-      for (uint8_t j = 0; j < _samplesPerSensor; j++)
+      for (uint16_t j = 0; j < conversions; j++)
       {
         for (uint8_t i = start; i < _sensorCount; i += step)
         {
           // add the conversion result
-          sensorValues[i] += analogRead(_sensorPins[i]);
+          uint16_t value = analogRead(_sensorPins[i]);
+          if (sums != nullptr) { sums[i] += value; }
+          else { sensorValues[i] += value; }
         }
       }
 
       // get the rounded average of the readings for each sensor
       for (uint8_t i = start; i < _sensorCount; i += step)
       {
-        sensorValues[i] = (sensorValues[i] + (_samplesPerSensor >> 1)) /
-          _samplesPerSensor;
+        uint32_t sum = (sums != nullptr) ? sums[i] : sensorValues[i];
+        sensorValues[i] = (sum + (divisor >> 1)) / divisor;
       }
       return;
+    }
 
     default: // QTRType::Undefined or invalid - do nothing
       return;
   }
 }
 
-uint16_t QTRSensors::readLinePrivate(uint16_t * sensorValues, QTRReadMode mode,
-                         bool invertReadings)
+// Returns whether readPrivate() needs the scan for the current read and
+// settings: the loops in readPrivate() only cover the defaults of the
+// settings that install the scan with useScan().
+bool QTRSensors::scanNeeded()
 {
-  bool onLine = false;
-  uint32_t avg = 0; // this is for the weighted total
-  uint16_t sum = 0; // this is for the denominator, which is <= 64000
-
-  // manual emitter control is not supported
-  if (mode == QTRReadMode::Manual) { return 0; }
-
-  readCalibrated(sensorValues, mode);
+  if (_readMasked) { return true; }
 
-  for (uint8_t i = 0; i < _sensorCount; i++)
+  switch (_type)
   {
-    uint16_t value = sensorValues[i];
-    if (invertReadings) { value = 1000 - value; }
+    case QTRType::RC:
+      return (_rcTiming != QTRRCTiming::Polled);
 
-    // keep track of whether we see the line at all
-    if (value > 200) { onLine = true; }
+    case QTRType::Analog:
+      return (_analogTiming != QTRAnalogTiming::Blocking) ||
+             (_sampleReduction != QTRSampleReduction::Mean) ||
+             (_sampleOrder != QTRSampleOrder::Interleaved);
+
+    default:
+      return false;
+  }
+}
+
+// Reads the sensors selected as described for readPrivate() with a scan,
+// waiting for it to finish.
+void QTRSensors::scanRead(QTRSensors & sensors, uint16_t * sensorValues,
+                          uint8_t start, uint8_t step)
+{
+  if (!sensors.startScan(sensorValues, start, step)) { return; }
+
+  while (!sensors.continueScan()) {}
+}
+
+// Starts a scan of the sensors selected as described for readPrivate(). Returns
+// false if there is nothing to scan.
+bool QTRSensors::startScan(uint16_t * sensorValues, uint8_t start, uint8_t step)
+{
+  if (_sensorPins == nullptr) { return false; }
+
+  // stop any scan that is still timing sensors with interrupts
+  stopScan();
+  _scanRelease = releaseScan;
+
+  _scanValues = sensorValues;
+  _scanStep = step;
+
+  // Start with the first selected sensor if the mask of a masked read
+  // leaves out the first one.
+  if (!readIncludes(start)) { start = nextScanSensor(start); }
+  if (start >= _sensorCount) { return false; }
+  _scanStart = start;
+  _scanCount = 0;
+
+  switch (_type)
+  {
+    case QTRType::RC:
+      _scanDischarging = false;
+
+      if (_rcTiming == QTRRCTiming::Interrupt)
+      {
+        // The interrupts ignore the lines until they are released, so they
+        // can be attached before charging.
+        _scanInterrupts = attachSensorInterrupts();
+      }
+
+      for (uint8_t i = start; i < _sensorCount; i = nextScanSensor(i))
+      {
+        sensorValues[i] = _maxValue;
+        // make sensor line an output (drives low briefly, but doesn't matter)
+        pinMode(_sensorPins[i], OUTPUT);
+        // drive sensor line high
+        digitalWrite(_sensorPins[i], HIGH);
+      }
+
+      // record when the lines started charging
+      _scanStartTime = micros();
+      return true;
+
+    case QTRType::Analog:
+    {
+      uint8_t samples = _samplesPerSensor;
+
+      // The number of conversions added up in each sum, and the rounding
+      // added to the sum when it is divided. With the mean, all of the
+      // conversions of a sensor are added up; otherwise, each sample is kept
+      // for reduceSamples(), so only the conversions of one sample are.
+      uint16_t sumConversions;
+      uint16_t rounding;
+
+      // If there is no room to keep the samples (because memory allocation
+      // failed or the buffer set with setBuffer() does not include them),
+      // they are averaged instead.
+      _scanKeepSamples = false;
+      if ((_sampleReduction != QTRSampleReduction::Mean) &&
+          ((_sampleSets != nullptr) ||
+           allocateArray(_sampleSets, _sensorCount)))
+      {
+        if (samples > QTRMaxSortedSamples) { samples = QTRMaxSortedSamples; }
+        _scanKeepSamples = true;
+
+        sumConversions = 1 << (2 * _oversampling);
+        rounding = (1 << _oversampling) >> 1;
+      }
+      else
+      {
+        sumConversions = (uint16_t)samples << (2 * _oversampling);
+        rounding = ((uint16_t)samples << _oversampling) >> 1;
+      }
+
+      // With oversampling, each sample is made up of 4^n conversions.
+      _scanConversions = (uint16_t)samples << (2 * _oversampling);
+      _scanConversionsTaken = 0;
+      _scanIndex = start;
+
+      // When the conversions are taken in bursts, only one sensor's sum is
+      // needed at a time, and it is kept in _scanSum. Otherwise, the sums are
+      // kept in the values array, or in _analogSums if they (plus the
+      // rounding) might not fit in 16 bits. If _analogSums can't be used,
+      // the conversions are taken in bursts instead.
+      _scanWideSums = false;
+      _scanSum = 0;
+      _scanBurst = (_sampleOrder != QTRSampleOrder::Interleaved);
+      if (!_scanBurst &&
+          ((uint32_t)sumConversions * ((1UL << _analogResolution) - 1) +
+           rounding > 0xFFFF))
+      {
+        if ((_analogSums != nullptr) ||
+            allocateArray(_analogSums, _sensorCount))
+        {
+          _scanWideSums = true;
+        }
+        else
+        {
+          _scanBurst = true;
+        }
+      }
+
+      // reset the values
+      for (uint8_t i = start; i < _sensorCount; i = nextScanSensor(i))
+      {
+        sensorValues[i] = 0;
+        if (_scanWideSums) { _analogSums[i] = 0; }
+      }
+
+      // record when sampling started (only used for timing statistics)
+      _scanStartTime = micros();
+
+#if QTR_ADC_INTERRUPTS
+      if (_analogTiming == QTRAnalogTiming::Interrupt)
+      {
+        _scanAdc = startAdcScan();
+      }
+#endif
+      return true;
+    }
+
+    default: // QTRType::Undefined or invalid - do nothing
+      return false;
+  }
+}
+
+// Advances the scan started by startScan(). Apart from analog conversions,
+// this does not block: each call takes at most one set of RC readings or one
+// sample per analog sensor. Returns true once the scan is finished.
+bool QTRSensors::continueScan()
+{
+  uint16_t * sensorValues = _scanValues;
+  uint8_t start = _scanStart;
+
+  switch (_type)
+  {
+    case QTRType::RC:
+      if (!_scanDischarging)
+      {
+        // charge lines for 10 us
+        if ((uint16_t)(micros() - _scanStartTime) < 10) { return false; }
+
+        // mark the sensors being read as pending on their ports
+        for (uint8_t p = 0; p < _sensorPortCount; p++)
+        {
+          _sensorPorts[p].pending = 0;
+        }
+        if (_sensorPortCount != 0)
+        {
+          for (uint8_t i = start; i < _sensorCount; i = nextScanSensor(i))
+          {
+            _sensorPorts[_sensorBits[i].port].pending |= _sensorBits[i].mask;
+          }
+        }
+
+        // disable interrupts so we can switch all the pins as close to the same
+        // time as possible
+        InterruptState state = disableInterrupts();
+
+        QTR_RECORD_PHASE(QTRPhase::Charge, _scanStartTime);
+
+        // record start time before the first sensor is switched to input
+        // (similarly, time is checked before the first sensor is read below)
+        _scanStartTime = micros();
+
+        for (uint8_t i = start; i < _sensorCount; i = nextScanSensor(i))
+        {
+          // make sensor line an input (should also ensure pull-up is disabled)
+          pinMode(_sensorPins[i], INPUT);
+          _scanCount++; // number of sensors that have not discharged yet
+        }
+
+        _scanDischarging = true;
+
+        restoreInterrupts(state);
+      }
+
+      if (_scanInterrupts)
+      {
+        // The interrupt handlers record the readings; just wait for the
+        // timeout (or, with early exit enabled, for every sensor to
+        // discharge).
+        if (((uint16_t)(micros() - _scanStartTime) < _maxValue) &&
+            (!_earlyExit || (_scanCount != 0)))
+        {
+          return false;
+        }
+
+        detachSensorInterrupts();
+        QTR_RECORD_PHASE(QTRPhase::Discharge, _scanStartTime);
+        return true;
+      }
+
+      // with early exit enabled, stop as soon as every sensor has discharged
+      if (_earlyExit && (_scanCount == 0))
+      {
+        QTR_RECORD_PHASE(QTRPhase::Discharge, _scanStartTime);
+        return true;
+      }
+
+      {
+        // disable interrupts so we can read all the pins as close to the same
+        // time as possible
+        InterruptState state = disableInterrupts();
+
+        uint16_t time = micros() - _scanStartTime;
+        if (time >= _maxValue)
+        {
+          restoreInterrupts(state);
+          QTR_RECORD_PHASE(QTRPhase::Discharge, _scanStartTime);
+          return true;
+        }
+
+        if (_sensorPortCount != 0)
+        {
+          _scanCount -= pollSensorPorts(sensorValues, time, start, _scanStep);
+        }
+        else
+        {
+          for (uint8_t i = start; i < _sensorCount; i = nextScanSensor(i))
+          {
+            if ((digitalRead(_sensorPins[i]) == LOW) && (time < sensorValues[i]))
+            {
+              // record the first time the line reads low
+              sensorValues[i] = time;
+              _scanCount--;
+            }
+          }
+        }
+
+        restoreInterrupts(state);
+      }
+      return false;
+
+    case QTRType::Analog:
+#if QTR_ADC_INTERRUPTS
+      if (_scanAdc)
+      {
+        // The interrupt handler adds up the conversion results and releases
+        // the ADC when it has taken all of them; just wait for it to finish.
+        if (_adcSensors == this) { return false; }
+        _scanAdc = false;
+
+        // make sure the sums are read after seeing that they are complete
+        __asm__ __volatile__("" ::: "memory");
+      }
+      else
+#endif
+      if (!_scanBurst)
+      {
+        uint16_t conversion = _scanConversionsTaken + 1;
+        for (uint8_t i = start; i < _sensorCount; i = nextScanSensor(i))
+        {
+          // add the conversion result
+          addConversion(i, analogRead(_sensorPins[i]), conversion);
+        }
+
+        _scanConversionsTaken = conversion;
+        if (conversion < _scanConversions) { return false; }
+      }
+      else
+      {
+        // Take all of the conversions of the next sensor in a burst, so the
+        // ADC only switches channels once per sensor.
+        uint8_t i = _scanIndex;
+        uint8_t pin = _sensorPins[i];
+
+        if (_sampleOrder == QTRSampleOrder::BurstDiscardFirst)
+        {
+          // let the sample-and-hold capacitor settle on the new channel
+          analogRead(pin);
+        }
+
+        for (uint16_t conversion = 1; conversion <= _scanConversions; conversion++)
+        {
+          addConversion(i, analogRead(pin), conversion);
+        }
+
+        _scanIndex = nextScanSensor(i);
+        if (_scanIndex < _sensorCount) { return false; }
+      }
+
+      if (_scanKeepSamples)
+      {
+        // combine the samples kept for each sensor
+        for (uint8_t i = start; i < _sensorCount; i = nextScanSensor(i))
+        {
+          sensorValues[i] = reduceSamples(_sampleSets[i].values);
+        }
+      }
+      else if (!_scanBurst)
+      {
+        // Get the rounded average of the readings for each sensor. With
+        // oversampling, this also shifts each sample's sum of 4^n conversions
+        // right by n. (In bursts, addConversion() has already done this.)
+        uint16_t divisor = (uint16_t)_samplesPerSensor << _oversampling;
+        for (uint8_t i = start; i < _sensorCount; i = nextScanSensor(i))
+        {
+          if (_scanWideSums)
+          {
+            sensorValues[i] = (_analogSums[i] + (divisor >> 1)) / divisor;
+          }
+          else
+          {
+            sensorValues[i] = (sensorValues[i] + (divisor >> 1)) / divisor;
+          }
+        }
+      }
+      QTR_RECORD_PHASE(QTRPhase::Analog, _scanStartTime);
+      return true;
+
+    default: // QTRType::Undefined or invalid - do nothing
+      return true;
+  }
+}
+
+// Called by stopScan() once a scan has been started.
+void QTRSensors::releaseScan(QTRSensors & sensors)
+{
+  if (sensors._scanInterrupts) { sensors.detachSensorInterrupts(); }
+#if QTR_ADC_INTERRUPTS
+  if (sensors._scanAdc) { sensors.stopAdcScan(); }
+#endif
+}
+
+#if QTR_PCINT_INTERRUPTS
+
+// defined by QTR_PCINT_ISR along with the pin change interrupt handlers
+extern "C" void qtrPcintIsrDefined() __attribute__((weak));
+
+// Enables pin change interrupts that record when each of the selected sensor
+// lines goes low. Returns false (and enables nothing) if the handlers have not
+// been defined, the pins are not grouped by port, any of the pins does not
+// support pin change interrupts, or another object's interrupts are enabled.
+bool QTRSensors::attachSensorInterrupts()
+{
+#if defined(digitalPinToPCICR)
+  // The interrupt handlers must have been defined with QTR_PCINT_ISR.
+  if (qtrPcintIsrDefined == nullptr) { return false; }
+
+  if (_interruptSensors != nullptr) { return false; }
+
+  // The handlers poll the ports to see which lines have gone low.
+  if (_sensorPortCount == 0) { return false; }
+
+  for (uint8_t i = _scanStart; i < _sensorCount; i = nextScanSensor(i))
+  {
+    if (digitalPinToPCICR(_sensorPins[i]) == nullptr) { return false; }
+  }
+
+  _interruptSensors = this;
+
+  InterruptState state = disableInterrupts();
+
+  for (uint8_t i = _scanStart; i < _sensorCount; i = nextScanSensor(i))
+  {
+    uint8_t pin = _sensorPins[i];
+    *digitalPinToPCMSK(pin) |= 1 << digitalPinToPCMSKbit(pin);
+    // clear any change flagged before this read, then enable the interrupt
+    PCIFR = 1 << digitalPinToPCICRbit(pin);
+    *digitalPinToPCICR(pin) |= 1 << digitalPinToPCICRbit(pin);
+  }
+
+  restoreInterrupts(state);
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+void QTRSensors::detachSensorInterrupts()
+{
+#if defined(digitalPinToPCICR)
+  InterruptState state = disableInterrupts();
+
+  _scanDischarging = false;
+
+  for (uint8_t i = _scanStart; i < _sensorCount; i = nextScanSensor(i))
+  {
+    uint8_t pin = _sensorPins[i];
+    volatile uint8_t * pcmsk = digitalPinToPCMSK(pin);
+    *pcmsk &= ~(1 << digitalPinToPCMSKbit(pin));
+    // disable the group's interrupt once none of its pins are used
+    if (*pcmsk == 0)
+    {
+      *digitalPinToPCICR(pin) &= ~(1 << digitalPinToPCICRbit(pin));
+    }
+  }
+
+  _scanInterrupts = false;
+  _interruptSensors = nullptr;
+
+  restoreInterrupts(state);
+#endif
+}
+
+void QTRSensors::recordPinChanges()
+{
+  // ignore the lines until they have been charged and released
+  if (!_scanDischarging) { return; }
+
+  uint16_t time = micros() - _scanStartTime;
+  _scanCount -= pollSensorPorts(_scanValues, time, _scanStart, _scanStep);
+}
+
+void QTRSensors::handlePinChangeInterrupt()
+{
+  QTRSensors * sensors = _interruptSensors;
+  if (sensors != nullptr) { sensors->recordPinChanges(); }
+}
+
+#elif !defined(__AVR__)
+
+// Attaches interrupts that record when each of the selected sensor lines goes
+// low. Returns false (and attaches nothing) if any of the pins does not support
+// interrupts or another object's interrupts are attached.
+bool QTRSensors::attachSensorInterrupts()
+{
+  if (_interruptSensors != nullptr) { return false; }
+
+  // there are only handlers for the first InterruptSensorCount sensors
+  if (_sensorCount > InterruptSensorCount) { return false; }
+
+  for (uint8_t i = _scanStart; i < _sensorCount; i = nextScanSensor(i))
+  {
+    if (digitalPinToInterrupt(_sensorPins[i]) == NOT_AN_INTERRUPT) { return false; }
+  }
+
+  _interruptSensors = this;
+
+  for (uint8_t i = _scanStart; i < _sensorCount; i = nextScanSensor(i))
+  {
+    attachInterrupt(digitalPinToInterrupt(_sensorPins[i]), _sensorInterrupts[i], FALLING);
+  }
+
+  return true;
+}
+
+void QTRSensors::detachSensorInterrupts()
+{
+  _scanDischarging = false;
+
+  for (uint8_t i = _scanStart; i < _sensorCount; i = nextScanSensor(i))
+  {
+    detachInterrupt(digitalPinToInterrupt(_sensorPins[i]));
+  }
+
+  _scanInterrupts = false;
+  _interruptSensors = nullptr;
+}
+
+void QTRSensors::recordDischarge(uint8_t index)
+{
+  // ignore the line until it has been charged and released
+  if (!_scanDischarging) { return; }
+
+  uint16_t time = micros() - _scanStartTime;
+  if (time < _scanValues[index])
+  {
+    // record the first time the line goes low
+    _scanValues[index] = time;
+    _scanCount--;
+  }
+}
+
+template <uint8_t Index>
+void QTRSensors::sensorInterrupt()
+{
+  QTRSensors * sensors = _interruptSensors;
+  if (sensors != nullptr) { sensors->recordDischarge(Index); }
+}
+
+void (* const QTRSensors::_sensorInterrupts[QTRSensors::InterruptSensorCount])() = {
+  sensorInterrupt<0>,  sensorInterrupt<1>,  sensorInterrupt<2>,  sensorInterrupt<3>,
+  sensorInterrupt<4>,  sensorInterrupt<5>,  sensorInterrupt<6>,  sensorInterrupt<7>,
+  sensorInterrupt<8>,  sensorInterrupt<9>,  sensorInterrupt<10>, sensorInterrupt<11>,
+  sensorInterrupt<12>, sensorInterrupt<13>, sensorInterrupt<14>, sensorInterrupt<15>,
+  sensorInterrupt<16>, sensorInterrupt<17>, sensorInterrupt<18>, sensorInterrupt<19>,
+  sensorInterrupt<20>, sensorInterrupt<21>, sensorInterrupt<22>, sensorInterrupt<23>,
+  sensorInterrupt<24>, sensorInterrupt<25>, sensorInterrupt<26>, sensorInterrupt<27>,
+  sensorInterrupt<28>, sensorInterrupt<29>, sensorInterrupt<30>
+};
+
+#else
+
+// Pin change interrupts are not supported on this AVR, and attachInterrupt()
+// is not used on AVR, so interrupt timing always falls back to polling.
+bool QTRSensors::attachSensorInterrupts() { return false; }
+
+void QTRSensors::detachSensorInterrupts() {}
+
+#endif
+
+#if QTR_PCINT_INTERRUPTS || !defined(__AVR__)
+QTRSensors * volatile QTRSensors::_interruptSensors = nullptr;
+#endif
+
+// Adds an analog conversion result for sensor [index] to its sum. [conversion]
+// is the number of conversions of that sensor so far in this scan, including
+// this one. If the samples are being kept for reduceSamples(), every 4^n
+// conversions this shifts the sum right by n (rounded), keeps it as a sample,
+// and starts the next sum. In bursts, the average is stored after the last
+// conversion of the sensor.
+void QTRSensors::addConversion(uint8_t index, uint16_t value, uint16_t conversion)
+{
+  uint32_t sum;
+  if (_scanBurst) { sum = (_scanSum += value); }
+  else if (_scanWideSums) { sum = (_analogSums[index] += value); }
+  else { sum = (_scanValues[index] += value); }
+
+  if (_scanKeepSamples)
+  {
+    if ((conversion & ((1 << (2 * _oversampling)) - 1)) != 0) { return; }
+
+    uint8_t sample = (conversion >> (2 * _oversampling)) - 1;
+    _sampleSets[index].values[sample] =
+      (sum + ((1 << _oversampling) >> 1)) >> _oversampling;
+  }
+  else if (_scanBurst && (conversion == _scanConversions))
+  {
+    // Get the rounded average, as continueScan() does for the other orders.
+    uint16_t divisor = (uint16_t)_samplesPerSensor << _oversampling;
+    _scanValues[index] = (sum + (divisor >> 1)) / divisor;
+  }
+  else
+  {
+    return;
+  }
+
+  // start the next sum
+  if (_scanBurst) { _scanSum = 0; }
+  else if (_scanWideSums) { _analogSums[index] = 0; }
+  else { _scanValues[index] = 0; }
+}
+
+// Combines the samples kept for one sensor as selected with
+// setSampleReduction(). This reorders the samples.
+uint16_t QTRSensors::reduceSamples(uint16_t * samples)
+{
+  uint8_t count = _scanConversions >> (2 * _oversampling);
+
+  // the range of samples to average
+  uint8_t first = 0;
+  uint8_t last = count;
+
+  switch (_sampleReduction)
+  {
+    case QTRSampleReduction::Median:
+      sortSamples(samples, count);
+      first = (count - 1) / 2;
+      last = count / 2 + 1;
+      break;
+
+    case QTRSampleReduction::TrimmedMean:
+      sortSamples(samples, count);
+      first = count / 4;
+      last = count - first;
+      break;
+
+    case QTRSampleReduction::MinMaxRejection:
+      if (count >= 3)
+      {
+        // Move the lowest sample to the start and the highest one to the
+        // end; the rest do not need to be sorted.
+        uint8_t j = 0;
+        for (uint8_t i = 1; i < count; i++)
+        {
+          if (samples[i] < samples[j]) { j = i; }
+        }
+        uint16_t temp = samples[0]; samples[0] = samples[j]; samples[j] = temp;
+
+        j = 1;
+        for (uint8_t i = 2; i < count; i++)
+        {
+          if (samples[i] > samples[j]) { j = i; }
+        }
+        temp = samples[count - 1]; samples[count - 1] = samples[j]; samples[j] = temp;
+
+        first = 1;
+        last = count - 1;
+      }
+      break;
+
+    default: // QTRSampleReduction::Mean
+      break;
+  }
+
+  uint32_t sum = 0;
+  for (uint8_t i = first; i < last; i++)
+  {
+    sum += samples[i];
+  }
+
+  uint8_t n = last - first;
+  return (sum + (n >> 1)) / n;
+}
+
+// Comparators of the sorting networks used by sortSamples() for 2 to 8
+// values, each packed into a byte as the indexes of the two values to put in
+// order.
+static const uint8_t sortingNetworks[] PROGMEM = {
+  // 2 values
+  0x01,
+  // 3 values
+  0x02, 0x01, 0x12,
+  // 4 values
+  0x02, 0x13, 0x01, 0x23, 0x12,
+  // 5 values
+  0x03, 0x14, 0x02, 0x13, 0x01, 0x24, 0x12, 0x34, 0x23,
+  // 6 values
+  0x05, 0x13, 0x24, 0x12, 0x34, 0x03, 0x25, 0x01, 0x23, 0x45, 0x12, 0x34,
+  // 7 values
+  0x06, 0x23, 0x45, 0x02, 0x14, 0x36, 0x01, 0x25, 0x34, 0x12, 0x46, 0x23,
+  0x45, 0x12, 0x34, 0x56,
+  // 8 values
+  0x02, 0x13, 0x46, 0x57, 0x04, 0x15, 0x26, 0x37, 0x01, 0x23, 0x45, 0x67,
+  0x24, 0x35, 0x14, 0x36, 0x12, 0x34, 0x56,
+};
+
+// where the network for each number of values starts in sortingNetworks,
+// followed by the end of the last one
+static const uint8_t sortingNetworkStarts[] PROGMEM = {
+  0, 1, 4, 9, 18, 30, 46, 65
+};
+
+static_assert(QTRMaxSortedSamples <= 8,
+  "sortingNetworks only covers up to 8 values.");
+
+// Sorts [count] samples (up to QTRMaxSortedSamples) in place, in ascending
+// order.
+void QTRSensors::sortSamples(uint16_t * samples, uint8_t count)
+{
+  if (count < 2) { return; }
+
+  uint8_t end = pgm_read_byte(&sortingNetworkStarts[count - 1]);
+  for (uint8_t c = pgm_read_byte(&sortingNetworkStarts[count - 2]); c < end; c++)
+  {
+    uint8_t comparator = pgm_read_byte(&sortingNetworks[c]);
+    uint16_t & a = samples[comparator >> 4];
+    uint16_t & b = samples[comparator & 0x0F];
+    if (a > b)
+    {
+      uint16_t temp = a;
+      a = b;
+      b = temp;
+    }
+  }
+}
+
+#if QTR_ADC_INTERRUPTS
+// defined by QTR_ADC_ISR along with the ADC interrupt handler
+extern "C" void qtrAdcIsrDefined() __attribute__((weak));
+
+bool QTRSensors::startAdcScan()
+{
+  // The interrupt handler must have been defined with QTR_ADC_ISR.
+  if (qtrAdcIsrDefined == nullptr) { return false; }
+
+  if (_adcSensors != nullptr) { return false; }
+
+  if (!_adcReferenceSet)
+  {
+    // Let analogRead() apply the reference selected with analogReference().
+    analogRead(_sensorPins[_scanStart]);
+    _adcReferenceSet = true;
+  }
+
+  _adcSensors = this;
+  _scanIndex = _scanStart;
+  _scanDiscard = (_sampleOrder == QTRSampleOrder::BurstDiscardFirst);
+  selectAdcChannel(_sensorPins[_scanStart]);
+
+  // Start the first conversion with the interrupt enabled. (This also clears
+  // the interrupt flag, which analogRead() leaves set.)
+  ADCSRA |= (1 << ADIF) | (1 << ADIE) | (1 << ADSC);
+  return true;
+}
+
+void QTRSensors::stopAdcScan()
+{
+  ADCSRA &= ~(1 << ADIE);
+  if (_adcSensors == this) { _adcSensors = nullptr; }
+  _scanAdc = false;
+}
+
+void QTRSensors::recordConversion()
+{
+  uint8_t i = _scanIndex;
+
+  if (_scanDiscard)
+  {
+    // ignore the first conversion after switching to a sensor
+    _scanDiscard = false;
+    ADCSRA |= (1 << ADSC);
+    return;
+  }
+
+  if (!_scanBurst)
+  {
+    addConversion(i, ADC, _scanConversionsTaken + 1);
+
+    i = nextScanSensor(i);
+    if (i >= _sensorCount)
+    {
+      // finished a conversion of every sensor
+      i = _scanStart;
+      if (++_scanConversionsTaken >= _scanConversions)
+      {
+        ADCSRA &= ~(1 << ADIE);
+        _adcSensors = nullptr;
+        return;
+      }
+    }
+  }
+  else
+  {
+    addConversion(i, ADC, ++_scanConversionsTaken);
+
+    if (_scanConversionsTaken >= _scanConversions)
+    {
+      // finished the burst for this sensor
+      _scanConversionsTaken = 0;
+      i = nextScanSensor(i);
+      if (i >= _sensorCount)
+      {
+        ADCSRA &= ~(1 << ADIE);
+        _adcSensors = nullptr;
+        return;
+      }
+      _scanDiscard = (_sampleOrder == QTRSampleOrder::BurstDiscardFirst);
+    }
+  }
+
+  // start the next conversion
+  _scanIndex = i;
+  selectAdcChannel(_sensorPins[i]);
+  ADCSRA |= (1 << ADSC);
+}
+
+// Selects the ADC channel for an analog pin, keeping the reference selected by
+// analogRead(). This follows the pin numbering used by analogRead().
+void QTRSensors::selectAdcChannel(uint8_t pin)
+{
+#if defined(__AVR_ATmega32U4__)
+  if (pin >= 18) { pin -= 18; } // allow for channel or pin numbers
+  uint8_t channel = analogPinToChannel(pin);
+#elif defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+  uint8_t channel = (pin >= 54) ? (pin - 54) : pin;
+#else
+  uint8_t channel = (pin >= 14) ? (pin - 14) : pin;
+#endif
+
+#if defined(MUX5)
+  ADCSRB = (ADCSRB & ~(1 << MUX5)) | (((channel >> 3) & 0x01) << MUX5);
+#endif
+  ADMUX = (ADMUX & 0xC0) | (channel & 0x07);
+}
+
+void QTRSensors::handleAdcInterrupt()
+{
+  QTRSensors * sensors = _adcSensors;
+  if (sensors != nullptr)
+  {
+    sensors->recordConversion();
+  }
+  else
+  {
+    ADCSRA &= ~(1 << ADIE);
+  }
+}
+
+QTRSensors * volatile QTRSensors::_adcSensors = nullptr;
+#endif
+
+// Reads each port that has pending RC sensors once and records the current
+// time for any of the first of every [step] sensors, starting with [start],
+// that have discharged. (Only the sensors being read are pending, so this
+// also follows the mask of a masked read.) Returns the number of sensors
+// recorded.
+uint8_t QTRSensors::pollSensorPorts(uint16_t * sensorValues, uint16_t time,
+                                    uint8_t start, uint8_t step)
+{
+  uint8_t recorded = 0;
+
+  for (uint8_t p = 0; p < _sensorPortCount; p++)
+  {
+    // find the pending lines on this port that have gone low
+    PortMask low = _sensorPorts[p].pending & ~*_sensorPorts[p].input;
+    if (low == 0) { continue; }
+
+    _sensorPorts[p].pending &= ~low;
+
+    for (uint8_t i = start; i < _sensorCount; i += step)
+    {
+      if ((_sensorBits[i].port == p) && (_sensorBits[i].mask & low) &&
+          (time < sensorValues[i]))
+      {
+        // record the first time the line reads low
+        sensorValues[i] = time;
+        recorded++;
+      }
+    }
+  }
+
+  return recorded;
+}
+
+QTRPosition QTRSensors::readLinePrivate(uint16_t * sensorValues, QTRReadMode mode,
+                                        bool invertReadings)
+{
+  // manual emitter control is not supported
+  if (mode == QTRReadMode::Manual) { return 0; }
+
+  readCalibrated(sensorValues, mode);
+
+  return linePosition(sensorValues, invertReadings);
+}
+
+QTRPosition QTRSensors::linePosition(const uint16_t * sensorValues,
+                                     bool invertReadings)
+{
+  QTR_TIME_PHASE(QTRPhase::Line);
+
+  bool onLine = false;
+#if QTR_MAX_SENSORS > 92
+  // the weighted total can exceed 32 bits with this many sensors
+  typedef uint64_t LineTotal;
+#else
+  typedef uint32_t LineTotal;
+#endif
+  LineTotal avg = 0; // this is for the weighted total
+  QTRPosition sum = 0; // this is for the denominator, which is <= 1000 * QTRMaxSensors
+  QTRPosition maxPosition = (QTRPosition)(_sensorCount - 1) * 1000;
+
+  for (uint8_t i = 0; i < _sensorCount; i++)
+  {
+    uint16_t value = sensorValues[i];
+    if (invertReadings) { value = 1000 - value; }
+
+    // keep track of whether we see the line at all
+    if (value > 200) { onLine = true; }
 
     // only average in values that are above a noise threshold
     if (value > 50)
     {
-      avg += (uint32_t)value * (i * 1000);
+      avg += (LineTotal)value * ((uint32_t)i * 1000);
       sum += value;
     }
   }
@@ -672,14 +2545,14 @@ uint16_t QTRSensors::readLinePrivate(uint16_t * sensorValues, QTRReadMode mode,
   if (!onLine)
   {
     // If it last read to the left of center, return 0.
-    if (_lastPosition < (_sensorCount - 1) * 1000 / 2)
+    if (_lastPosition < maxPosition / 2)
     {
       return 0;
     }
     // If it last read to the right of center, return the max.
     else
     {
-      return (_sensorCount - 1) * 1000;
+      return maxPosition;
     }
   }
 
@@ -690,11 +2563,9 @@ uint16_t QTRSensors::readLinePrivate(uint16_t * sensorValues, QTRReadMode mode,
 // the destructor frees up allocated memory
 QTRSensors::~QTRSensors()
 {
+  stopScan();
+
   releaseEmitterPins();
 
-  if (_sensorPins)            { free(_sensorPins); }
-  if (calibrationOn.maximum)  { free(calibrationOn.maximum); }
-  if (calibrationOff.maximum) { free(calibrationOff.maximum); }
-  if (calibrationOn.minimum)  { free(calibrationOn.minimum); }
-  if (calibrationOff.minimum) { free(calibrationOff.minimum); }
+  freeArrays();
 }
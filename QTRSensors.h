@@ -53,6 +53,77 @@ enum class QTRType : uint8_t {
   Analog
 };
 
+/// Methods for timing the discharge of RC sensors.
+enum class QTRRCTiming : uint8_t {
+  /// The sensors are polled in a loop, with interrupts briefly disabled each
+  /// time they are checked. This is the default.
+  Polled,
+
+  /// Each sensor line triggers an interrupt when it goes low, and the
+  /// interrupt handler records the time. Interrupts stay enabled throughout
+  /// the read, and the accuracy of the readings does not depend on how often
+  /// the sensors are checked. On AVR-based boards, this requires the
+  /// QTR_PCINT_ISR macro to be used in your sketch; see
+  /// QTRSensors::setRCTiming().
+  Interrupt
+};
+
+/// Methods for taking analog sensor readings.
+enum class QTRAnalogTiming : uint8_t {
+  /// Each reading is taken with `analogRead()`, which waits for the
+  /// conversion to finish. This is the default.
+  Blocking,
+
+  /// The ADC's conversion-complete interrupt starts the conversion for the
+  /// next sensor and adds up the results, so the CPU is free while the
+  /// conversions run. This is only supported on some AVR-based boards, and it
+  /// requires the QTR_ADC_ISR macro to be used in your sketch; see
+  /// QTRSensors::setAnalogTiming().
+  Interrupt
+};
+
+/// Ways of combining the samples taken of each analog sensor into a reading.
+enum class QTRSampleReduction : uint8_t {
+  /// The rounded average of the samples. This is the default.
+  Mean,
+
+  /// The middle sample (or the rounded average of the two middle samples if
+  /// there is an even number of them).
+  Median,
+
+  /// The rounded average of the samples after discarding the lowest quarter
+  /// and the highest quarter of them.
+  TrimmedMean,
+
+  /// The rounded average of the samples after discarding the lowest one and
+  /// the highest one.
+  MinMaxRejection
+};
+
+/// Orders for taking the conversions of analog sensors.
+enum class QTRSampleOrder : uint8_t {
+  /// One conversion of each sensor in turn, repeated until every sensor has
+  /// been sampled enough times. Samples of different sensors are taken close
+  /// together in time, but the ADC switches channels for every conversion.
+  /// This is the default.
+  Interleaved,
+
+  /// All of the conversions of one sensor, then all of the conversions of the
+  /// next. The ADC only switches channels once per sensor, which reduces
+  /// crosstalk between sensors.
+  Burst,
+
+  /// Like QTRSampleOrder::Burst, but the first conversion after switching to
+  /// each sensor is discarded, giving the ADC's sample-and-hold capacitor time
+  /// to settle. This helps most with high-impedance sensors, at the cost of
+  /// one extra conversion per sensor.
+  BurstDiscardFirst
+};
+
+/// The maximum number of samples per sensor used by the reductions other than
+/// QTRSampleReduction::Mean.
+const uint8_t QTRMaxSortedSamples = 8;
+
 /// Emitters selected to turn on or off.
 enum class QTREmitters : uint8_t {
   All,
@@ -67,8 +138,271 @@ const uint8_t QTRNoEmitterPin = 255;
 /// Default timeout for RC sensors (in microseconds).
 const uint16_t QTRRCDefaultTimeout = 2500;
 
-/// The maximum number of sensors supported by an instance of this class.
-const uint8_t QTRMaxSensors = 31;
+// The maximum number of sensors supported by an instance of QTRSensors can
+// be changed by defining this (from 1 to 254) before the library is compiled,
+// for example with a compiler flag such as -DQTR_MAX_SENSORS=64 for an array
+// made of several sensor boards. It must be the same for the whole program.
+// (Sensor indexes are 8-bit, and stepping past the last sensor when reading
+// every other one must not wrap around, so 255 is not allowed.)
+#ifndef QTR_MAX_SENSORS
+#define QTR_MAX_SENSORS 31
+#endif
+
+#if (QTR_MAX_SENSORS < 1) || (QTR_MAX_SENSORS > 254)
+#error "QTR_MAX_SENSORS must be between 1 and 254."
+#endif
+
+/// The maximum number of sensors supported by an instance of this class
+/// (31 unless QTR_MAX_SENSORS is defined).
+const uint8_t QTRMaxSensors = QTR_MAX_SENSORS;
+
+/// \brief The type of the line positions returned by
+/// QTRSensors::readLineBlack() and QTRSensors::readLineWhite().
+///
+/// This is a 16-bit type unless QTR_MAX_SENSORS is larger than 65, in which
+/// case the positions can be larger than 65535 and it is a 32-bit type.
+#if QTR_MAX_SENSORS > 65
+typedef uint32_t QTRPosition;
+#else
+typedef uint16_t QTRPosition;
+#endif
+
+// RC sensors are polled by reading whole I/O port input registers on
+// architectures where the Arduino core exposes them in a known format;
+// elsewhere, each sensor is polled with digitalRead().
+#if defined(__AVR__) || defined(ARDUINO_ARCH_SAM) || defined(ARDUINO_ARCH_SAMD)
+#define QTR_PORT_POLLING 1
+#else
+#define QTR_PORT_POLLING 0
+#endif
+
+// Interrupt-driven analog readings (QTRAnalogTiming::Interrupt) are supported
+// on AVR microcontrollers whose ADC channel numbering this library knows.
+#if defined(__AVR_ATmega168__) || defined(__AVR_ATmega328P__) || \
+    defined(__AVR_ATmega32U4__) || \
+    defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define QTR_ADC_INTERRUPTS 1
+#else
+#define QTR_ADC_INTERRUPTS 0
+#endif
+
+// Interrupt-timed RC readings (QTRRCTiming::Interrupt) use pin change
+// interrupts on AVR microcontrollers whose pin change interrupt vectors this
+// library knows, and attachInterrupt() on other architectures. (On AVR,
+// attachInterrupt() is never used, so that its external interrupt handlers
+// are not linked into every sketch that uses this library.)
+#if defined(__AVR_ATmega168__) || defined(__AVR_ATmega328P__) || \
+    defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define QTR_PCINT_INTERRUPTS 1
+#define QTR_PCINT_VECTORS 3
+#elif defined(__AVR_ATmega32U4__)
+#define QTR_PCINT_INTERRUPTS 1
+#define QTR_PCINT_VECTORS 1
+#else
+#define QTR_PCINT_INTERRUPTS 0
+#endif
+
+// QTRSensorsT charges, releases, and polls RC sensors through the I/O port
+// registers, with the port and bit of each pin worked out at compile time, on
+// AVR microcontrollers whose Arduino pin mapping this library knows (see
+// QTRPinTable).
+#if defined(__AVR_ATmega168__) || defined(__AVR_ATmega328P__) || \
+    defined(__AVR_ATmega32U4__) || \
+    defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define QTR_PIN_TABLES 1
+#else
+#define QTR_PIN_TABLES 0
+#endif
+
+// Per-phase timing statistics (see QTRSensors::getPhaseStats()) are only
+// compiled in if this is defined as 1 before the library is compiled, for
+// example with a compiler flag such as -DQTR_TIMING_STATS=1.
+#ifndef QTR_TIMING_STATS
+#define QTR_TIMING_STATS 0
+#endif
+
+// QTR_MAX_SENSORS and QTR_TIMING_STATS change the layout of QTRSensors, so
+// they must have the same values when the library is compiled as when your
+// sketch is (this is not the case if, for example, one of them is defined in
+// the sketch before this file is included instead of with a compiler flag).
+// To catch a mismatch, QTRSensors is declared in an inline namespace whose
+// name includes both values, so that the sketch fails to link, with undefined
+// references to functions in a namespace like
+// qtr_max_sensors_64_timing_stats_0, instead of misbehaving at run time. For
+// this to work, QTR_MAX_SENSORS must be defined as a plain number.
+#if QTR_TIMING_STATS
+#define QTR_CONFIG_TIMING_STATS 1
+#else
+#define QTR_CONFIG_TIMING_STATS 0
+#endif
+#define QTR_CONFIG_NAMESPACE2(maxSensors, timingStats) \
+  qtr_max_sensors_##maxSensors##_timing_stats_##timingStats
+#define QTR_CONFIG_NAMESPACE(maxSensors, timingStats) \
+  QTR_CONFIG_NAMESPACE2(maxSensors, timingStats)
+#define QTR_BEGIN_CONFIG_NAMESPACE \
+  inline namespace QTR_CONFIG_NAMESPACE(QTR_MAX_SENSORS, \
+                                        QTR_CONFIG_TIMING_STATS) {
+#define QTR_END_CONFIG_NAMESPACE }
+
+#if QTR_TIMING_STATS
+
+/// \brief Phases of a reading that are timed when QTR_TIMING_STATS is
+/// enabled.
+enum class QTRPhase : uint8_t {
+  /// A whole call to QTRSensors::read(), including the phases below that
+  /// happen during it.
+  Read,
+
+  /// A call to QTRSensors::emittersOn(), including waiting for the emitters
+  /// to turn on (if it waits).
+  EmittersOn,
+
+  /// A call to QTRSensors::emittersOff(), including waiting for the emitters
+  /// to turn off (if it waits).
+  EmittersOff,
+
+  /// Charging the RC sensor lines before they are released.
+  Charge,
+
+  /// Waiting for the RC sensor lines to discharge (or time out) after they
+  /// are released.
+  Discharge,
+
+  /// Taking all of the analog samples for one set of readings.
+  Analog,
+
+  /// Converting raw readings to calibrated values.
+  Calibration,
+
+  /// Computing the line position from calibrated values (not including
+  /// reading them).
+  Line
+};
+
+/// The number of members in ::QTRPhase.
+const uint8_t QTRPhaseCount = 8;
+
+/// \brief Timing statistics for one ::QTRPhase, in microseconds.
+struct QTRPhaseStats
+{
+  /// The number of times the phase was timed. Once this reaches 65535, no
+  /// more times are recorded.
+  uint16_t count;
+
+  /// The shortest time recorded.
+  uint16_t minimum;
+
+  /// The longest time recorded.
+  uint16_t maximum;
+
+  /// The sum of the times recorded.
+  uint32_t total;
+
+  /// Returns the mean of the times recorded, or 0 if none were recorded.
+  uint16_t mean() const { return (count == 0) ? 0 : (total / count); }
+};
+
+#endif
+
+/// \name QTRBuffer components
+///
+/// Optional parts of a QTRBuffer, which are combined with `|` to form its
+/// Features template parameter. The sizes given are per sensor on AVR-based
+/// boards. When a QTRSensors object uses a buffer without one of these
+/// components, it does without the array as described below instead of
+/// allocating it on the heap.
+/// \{
+
+/// The \link QTRSensors::CalibrationData calibration data \endlink arrays and
+/// the room QTRSensors::calibrate() needs while it runs (14 bytes). Without
+/// this component, calibrate() does nothing, so readCalibrated() and the
+/// line position functions cannot be used.
+const uint8_t QTRBufferCalibration = 0x01;
+
+/// Values that QTRSensors::readCalibrated() reuses from one reading to the
+/// next (22 bytes): the multipliers it uses instead of dividing, kept
+/// separately for the on, off, and combined on/off calibrations so that
+/// reads in different modes do not replace each other's, and the combined
+/// on/off calibration for the QTRReadMode::OnAndOff and
+/// QTRReadMode::OddEvenAndOff modes. Without this component, readCalibrated()
+/// returns the same values but takes longer.
+const uint8_t QTRBufferCalibrationCache = 0x02;
+
+/// The grouping of the sensor pins by I/O port that lets RC sensors be polled
+/// one port at a time (5 bytes; see QTRSensors::setSensorPins()). Without
+/// this component, RC sensors are polled one pin at a time with
+/// `digitalRead()`, and on AVR-based boards QTRRCTiming::Interrupt falls
+/// back to polling.
+const uint8_t QTRBufferPortPolling = 0x04;
+
+/// The off readings of the QTRReadMode::OnAndOff and
+/// QTRReadMode::OddEvenAndOff modes (2 bytes). Without this component, the
+/// library cannot read in those modes: QTRSensors::read() returns without
+/// reading, and QTRSensors::startRead() (and QTRAcquisition and
+/// QTRSensorGroup) fails to start.
+const uint8_t QTRBufferOffValues = 0x08;
+
+/// 32-bit sums of analog conversions (4 bytes). These are only needed to
+/// take the conversions in QTRSampleOrder::Interleaved order when the sum of
+/// one sensor's conversions can be more than 16 bits, which depends on
+/// QTRSensors::setSamplesPerSensor(), QTRSensors::setAnalogResolution(), and
+/// QTRSensors::setOversampling(). Without this component, those reads take
+/// the conversions in QTRSampleOrder::Burst order instead.
+const uint8_t QTRBufferAnalogSums = 0x10;
+
+/// The samples kept by the analog sample reductions other than
+/// QTRSampleReduction::Mean (16 bytes; see
+/// QTRSensors::setSampleReduction()). Without this component, the samples
+/// are averaged.
+const uint8_t QTRBufferSampleSets = 0x20;
+
+/// The components of a QTRBuffer if none are specified: QTRBufferCalibration,
+/// QTRBufferPortPolling, and QTRBufferOffValues.
+const uint8_t QTRBufferDefault =
+  QTRBufferCalibration | QTRBufferPortPolling | QTRBufferOffValues;
+
+/// All of the QTRBuffer components.
+const uint8_t QTRBufferAll = 0x3F;
+
+/// \}
+
+template <uint8_t Capacity, uint8_t Features> class QTRBuffer;
+template <QTRType Type, uint8_t... Pins> class QTRSensorsT;
+class QTRSensorGroup;
+
+/// \brief Interface for generating the pulses that set the dimming level of
+/// dimmable emitters.
+///
+/// By default, QTRSensors generates these pulses itself in software (see
+/// QTRSensors::setDimmer()). To generate them another way, such as with a
+/// timer or PWM peripheral on your board, derive a class from this one,
+/// implement sendPulses(), and pass an instance of it to
+/// QTRSensors::setDimmer().
+class QTRDimmer
+{
+  public:
+
+    /// \brief Sends dimming pulses to an emitter control pin.
+    ///
+    /// \param pin The Arduino digital pin that controls the emitters. It has
+    /// just been driven high to turn the emitters on.
+    ///
+    /// \param count The number of pulses to send (1 to 31).
+    ///
+    /// Each pulse must drive the pin low for 0.5 &micro;s to 300 &micro;s and
+    /// then high again, with the pin high for at least 0.5 &micro;s between
+    /// pulses, and the pin must be left high. The pulses must be finished
+    /// within 250 &micro;s of the pin going high, since the library only waits
+    /// that long (plus a margin) before reading the sensors; this function
+    /// may return before they are finished.
+    virtual void sendPulses(uint8_t pin, uint8_t count) = 0;
+
+  protected:
+
+    ~QTRDimmer() = default;
+};
+
+QTR_BEGIN_CONFIG_NAMESPACE
 
 /// \brief Represents a QTR sensor array.
 ///
@@ -86,6 +420,11 @@ class QTRSensors
 
     ~QTRSensors();
 
+    // An object owns its arrays (or points into its own QTRBuffer) and can
+    // own interrupt handlers, so a copy would free or use them twice.
+    QTRSensors(const QTRSensors &) = delete;
+    QTRSensors & operator=(const QTRSensors &) = delete;
+
     /// \brief Specifies that the sensors are RC.
     ///
     /// Call this function to set up RC-type sensors.
@@ -129,8 +468,61 @@ class QTRSensors
     /// values to be reallocated and reinitialized the next time calibrate() is
     /// called (it sets `calibrationOn.initialized` and
     /// `calibrationOff.initialized` to false).
+    ///
+    /// On AVR, SAM, and SAMD boards, this method also groups the pins by I/O
+    /// port, which allows RC sensors to be polled one port at a time instead
+    /// of one pin at a time. This makes the time it takes to poll the sensors
+    /// (and therefore the resolution of the RC readings) largely independent
+    /// of the number of sensors.
     void setSensorPins(const uint8_t * pins, uint8_t sensorCount);
 
+    /// \brief Returns the number of sensors.
+    ///
+    /// \return The number of sensors in use, which is less than the number
+    /// passed to setSensorPins() if the buffer could not hold them all.
+    ///
+    /// See also setSensorPins().
+    uint8_t getSensorCount() { return _sensorCount; }
+
+    /// \brief Makes this object keep its arrays in a buffer that you provide
+    /// instead of allocating them on the heap.
+    ///
+    /// \param buffer A QTRBuffer with room for as many sensors as you will
+    /// specify with setSensorPins(). It must stay valid for as long as this
+    /// object exists.
+    ///
+    /// By default, setSensorPins() and calibrate() allocate the arrays they
+    /// need with `realloc()`. On boards with little RAM, this can fragment the
+    /// heap or fail at run time. Once a buffer has been set, the library does
+    /// not use the heap at all: the sensor pins and the arrays of the
+    /// components selected by the buffer's Features template parameter (such
+    /// as the \link CalibrationData calibration data \endlink arrays) are
+    /// stored in the buffer, and the library does without the other arrays
+    /// as described for each component (see QTRBufferCalibration and the
+    /// constants that follow it).
+    ///
+    /// Example usage:
+    /// ~~~{.cpp}
+    /// QTRSensors qtr;
+    /// QTRBuffer<4> qtrBuffer; // default components
+    /// // or, to also cache the values readCalibrated() reuses:
+    /// // QTRBuffer<4, QTRBufferDefault | QTRBufferCalibrationCache> qtrBuffer;
+    ///
+    /// void setup()
+    /// {
+    ///   qtr.setBuffer(qtrBuffer);
+    ///   qtr.setTypeRC();
+    ///   qtr.setSensorPins((const uint8_t[]){6, 7, A0, A1}, 4);
+    /// }
+    /// ~~~
+    ///
+    /// If you call setSensorPins() with more sensors than the buffer can
+    /// hold, only as many sensors as fit are used. Pins that were already set
+    /// are kept, but any existing calibration is discarded. See also
+    /// QTRSensorsFixed, which contains its own buffer.
+    template <uint8_t Capacity, uint8_t Features>
+    void setBuffer(QTRBuffer<Capacity, Features> & buffer);
+
     /// \brief Sets the timeout for RC sensors.
     ///
     /// \param timeout The length of time, in microseconds, beyond which you
@@ -158,13 +550,135 @@ class QTRSensors
     /// See also setTimeout().
     uint16_t getTimeout() { return _timeout; }
 
+    /// \brief Enables or disables ending RC reads early.
+    ///
+    /// \param earlyExit If true, an RC read stops as soon as every sensor
+    /// being read has discharged, instead of always waiting for the full
+    /// timeout. The default is false.
+    ///
+    /// Enabling this does not change the values returned, but it can greatly
+    /// shorten RC reads on bright surfaces, where all of the sensors
+    /// discharge well before the timeout. Note that the time a read takes
+    /// then depends on what the sensors see, so leave this disabled if your
+    /// application relies on readings being taken at a steady rate.
+    ///
+    /// This setting only applies to RC sensors.
+    void setEarlyExit(bool earlyExit) { _earlyExit = earlyExit; }
+
+    /// \brief Returns whether RC reads end early.
+    ///
+    /// \return True if RC reads stop as soon as every sensor has discharged,
+    /// false otherwise.
+    ///
+    /// See also setEarlyExit().
+    bool getEarlyExit() { return _earlyExit; }
+
+    /// \brief Sets how the discharge of RC sensors is timed.
+    ///
+    /// \param timing The timing method, as a member of the ::QTRRCTiming
+    /// enum. The default is QTRRCTiming::Polled.
+    ///
+    /// QTRRCTiming::Interrupt records when each sensor line goes low with an
+    /// interrupt. On AVR-based boards, it uses pin change interrupts, which
+    /// almost every pin supports. These need interrupt handlers that this
+    /// library does not define itself so that they do not conflict with other
+    /// code using pin change interrupts (such as SoftwareSerial). To provide
+    /// them, put the line `QTR_PCINT_ISR` at file scope in one of your
+    /// sketch's files (outside of any function). The sensor pins must also be
+    /// grouped by port (see setSensorPins() and QTRBufferPortPolling). On
+    /// other boards, it uses `attachInterrupt()`, so every sensor pin must
+    /// support external interrupts (see `digitalPinToInterrupt()`), and there
+    /// can be at most 31 sensors; this is the case for all pins on many
+    /// ARM-based boards. If these requirements are not met, if the board is
+    /// not supported (see QTR_PCINT_INTERRUPTS), or if another QTRSensors
+    /// object is already using interrupt timing, the read falls back to
+    /// polling.
+    ///
+    /// With interrupt timing, read() still waits for the RC timeout (or for
+    /// all of the sensors to discharge, see setEarlyExit()), but interrupts
+    /// stay enabled while it does. When reading with startRead() and poll(),
+    /// the sensor readings no longer depend on how often poll() is called.
+    ///
+    /// This setting only applies to RC sensors.
+    void setRCTiming(QTRRCTiming timing)
+    {
+      _rcTiming = timing;
+      if (timing != QTRRCTiming::Polled) { useScan(); }
+    }
+
+    /// \brief Returns how the discharge of RC sensors is timed.
+    ///
+    /// \return The timing method as a member of the ::QTRRCTiming enum.
+    ///
+    /// See also setRCTiming().
+    QTRRCTiming getRCTiming() { return _rcTiming; }
+
+    /// \brief Sets how analog sensors are read.
+    ///
+    /// \param timing The method, as a member of the ::QTRAnalogTiming enum.
+    /// The default is QTRAnalogTiming::Blocking.
+    ///
+    /// With QTRAnalogTiming::Interrupt, the ADC's conversion-complete
+    /// interrupt steps through the sensors, starting each conversion as soon
+    /// as the previous one finishes and adding up the results. read() still
+    /// waits for the conversions (with interrupts enabled), but when reading
+    /// with startRead() and poll() (or QTRAcquisition), each call to poll()
+    /// returns right away instead of waiting for a set of conversions.
+    ///
+    /// This method needs an interrupt handler for the ADC, which this library
+    /// does not define itself so that it does not conflict with other code
+    /// using the ADC. To provide it, put the line `QTR_ADC_ISR` at file
+    /// scope in one of your sketch's files (outside of any function). If the
+    /// handler has not been provided, if the board is not supported (see
+    /// QTR_ADC_INTERRUPTS), or if another QTRSensors object is already using
+    /// the ADC this way, readings fall back to `analogRead()`.
+    ///
+    /// The first reading after this function is called uses `analogRead()`
+    /// once to apply the reference set with `analogReference()`, so call this
+    /// function again if you change the reference. Do not call `analogRead()`
+    /// yourself while the sensors are being read.
+    ///
+    /// This setting only applies to analog sensors.
+    void setAnalogTiming(QTRAnalogTiming timing)
+    {
+      _analogTiming = timing;
+      _adcReferenceSet = false;
+      if (timing != QTRAnalogTiming::Blocking) { useScan(); }
+    }
+
+    /// \brief Returns how analog sensors are read.
+    ///
+    /// \return The method, as a member of the ::QTRAnalogTiming enum.
+    ///
+    /// See also setAnalogTiming().
+    QTRAnalogTiming getAnalogTiming() { return _analogTiming; }
+
+#if QTR_ADC_INTERRUPTS
+    /// \brief Handles the ADC conversion-complete interrupt.
+    ///
+    /// This is called by the interrupt handler defined with QTR_ADC_ISR; you
+    /// should not need to call it yourself.
+    static void handleAdcInterrupt();
+#endif
+
+#if QTR_PCINT_INTERRUPTS
+    /// \brief Handles the pin change interrupts of RC sensor lines.
+    ///
+    /// This is called by the interrupt handlers defined with QTR_PCINT_ISR;
+    /// you should not need to call it yourself.
+    static void handlePinChangeInterrupt();
+#endif
+
     /// \brief Sets the number of analog readings to average per analog sensor.
     ///
-    /// \param samples The number of 10-bit analog samples (analog-to-digital
-    /// conversions) to average per sensor each time it is read.
+    /// \param samples The number of analog samples (analog-to-digital
+    /// conversions) to average per sensor each time it is read. If
+    /// oversampling is enabled with setOversampling(), each of these samples
+    /// is itself made up of several conversions.
     ///
     /// Increasing \p samples increases noise suppression at the cost of sample
-    /// rate. The maximum number of samples per sensor is 64; the default is 4.
+    /// rate. The maximum number of samples per sensor is 255; the default is
+    /// 4.
     ///
     /// The samples per sensor setting only applies to analog sensors.
     void setSamplesPerSensor(uint8_t samples);
@@ -177,6 +691,129 @@ class QTRSensors
     /// See also setSamplesPerSensor().
     uint16_t getSamplesPerSensor() { return _samplesPerSensor; }
 
+    /// \brief Sets how the samples of each analog sensor are combined.
+    ///
+    /// \param reduction The method, as a member of the ::QTRSampleReduction
+    /// enum. The default is QTRSampleReduction::Mean.
+    ///
+    /// The other methods reject outliers, such as a spike caused by motor
+    /// noise, so a few samples can give the same noise rejection as many
+    /// averaged ones. They keep every sample until the read is finished and
+    /// sort them with a small sorting network, so they use at most
+    /// ::QTRMaxSortedSamples samples per sensor; a larger setSamplesPerSensor()
+    /// is treated as that many. QTRSampleReduction::MinMaxRejection and
+    /// QTRSampleReduction::TrimmedMean need at least 3 and 4 samples per sensor
+    /// respectively to discard anything, and the median of 2 samples is their
+    /// average. If there is no memory for the samples (see
+    /// QTRBufferSampleSets), they are averaged as with
+    /// QTRSampleReduction::Mean.
+    ///
+    /// With oversampling (see setOversampling()), each sample is the
+    /// combination of several conversions as usual, and the samples are
+    /// reduced after that.
+    ///
+    /// This setting only applies to analog sensors.
+    void setSampleReduction(QTRSampleReduction reduction)
+    {
+      _sampleReduction = reduction;
+      _offValuesValid = false;
+      if (reduction != QTRSampleReduction::Mean) { useScan(); }
+    }
+
+    /// \brief Returns how the samples of each analog sensor are combined.
+    ///
+    /// \return The method, as a member of the ::QTRSampleReduction enum.
+    ///
+    /// See also setSampleReduction().
+    QTRSampleReduction getSampleReduction() { return _sampleReduction; }
+
+    /// \brief Sets the order in which analog sensors are sampled.
+    ///
+    /// \param order The order, as a member of the ::QTRSampleOrder enum. The
+    /// default is QTRSampleOrder::Interleaved.
+    ///
+    /// With QTRSampleOrder::Burst or QTRSampleOrder::BurstDiscardFirst, each
+    /// call to poll() while analog sensors are being read takes all of the
+    /// conversions of one sensor, instead of one conversion of every sensor.
+    ///
+    /// The examples/QTRBenchmark sketch measures the read time of each order,
+    /// so you can weigh it against the crosstalk on your board.
+    ///
+    /// QTRSampleOrder::Interleaved needs a 32-bit sum for each sensor if the
+    /// sum of its conversions can be more than 16 bits. If there is no memory
+    /// for those sums (see QTRBufferAnalogSums), such reads use
+    /// QTRSampleOrder::Burst order instead.
+    ///
+    /// This setting only applies to analog sensors.
+    void setSampleOrder(QTRSampleOrder order)
+    {
+      _sampleOrder = order;
+      _offValuesValid = false;
+      if (order != QTRSampleOrder::Interleaved) { useScan(); }
+    }
+
+    /// \brief Returns the order in which analog sensors are sampled.
+    ///
+    /// \return The order, as a member of the ::QTRSampleOrder enum.
+    ///
+    /// See also setSampleOrder().
+    QTRSampleOrder getSampleOrder() { return _sampleOrder; }
+
+    /// \brief Sets the resolution of the analog readings.
+    ///
+    /// \param bits The number of bits in the values returned by
+    /// `analogRead()`, from 1 to 16. The default is 10.
+    ///
+    /// This does not change the resolution of the ADC; it tells the library
+    /// what resolution to expect, so that the maximum raw value (and so the
+    /// calibration) is correct. For example, to use the 12-bit ADC on a SAMD
+    /// or Due board:
+    ///
+    /// ~~~{.cpp}
+    /// analogReadResolution(12);
+    /// qtr.setAnalogResolution(12);
+    /// ~~~
+    ///
+    /// With QTRAnalogTiming::Interrupt, the AVR ADC always produces 10-bit
+    /// values, so leave this at the default.
+    ///
+    /// Changing the resolution discards any existing calibration. This
+    /// setting only applies to analog sensors.
+    void setAnalogResolution(uint8_t bits);
+
+    /// \brief Returns the resolution of the analog readings.
+    ///
+    /// \return The number of bits in the values returned by `analogRead()`.
+    ///
+    /// See also setAnalogResolution().
+    uint8_t getAnalogResolution() { return _analogResolution; }
+
+    /// \brief Sets the number of bits of resolution added to the analog
+    /// readings by oversampling.
+    ///
+    /// \param extraBits The number of extra bits, from 0 to 4. The default is
+    /// 0 (no oversampling).
+    ///
+    /// With oversampling, each sample counted by setSamplesPerSensor() is made
+    /// by adding up 4<sup>\p extraBits</sup> conversions and shifting the sum
+    /// right by \p extraBits, so the readings are \p extraBits bits wider
+    /// than the resolution set with setAnalogResolution(). For example, with
+    /// the default 10-bit resolution and 2 extra bits, read() returns values
+    /// from 0 to 4092 and each sensor is converted 16 times per sample. This
+    /// only adds real resolution if there is some noise in the readings.
+    ///
+    /// The number of extra bits is limited so that the readings fit in 16
+    /// bits. Changing this setting discards any existing calibration. This
+    /// setting only applies to analog sensors.
+    void setOversampling(uint8_t extraBits);
+
+    /// \brief Returns the number of bits of resolution added by oversampling.
+    ///
+    /// \return The number of extra bits.
+    ///
+    /// See also setOversampling().
+    uint8_t getOversampling() { return _oversampling; }
+
     /// \brief Sets the emitter control pin for the sensors.
     ///
     /// \param emitterPin The Arduino digital pin that controls whether the IR
@@ -312,6 +949,28 @@ class QTRSensors
     /// pin/pins must be connected and defined for dimming to be applied.
     void setDimmingLevel(uint8_t dimmingLevel);
 
+    /// \brief Sets how the dimming level is applied to dimmable emitters.
+    ///
+    /// \param dimmer A pointer to an object that generates the dimming pulses
+    /// (see QTRDimmer), or `nullptr` (the default) to generate them in
+    /// software.
+    ///
+    /// In software, the library sends the pulses right after turning the
+    /// emitters on, which takes up to about 70 &micro;s at the highest dimming
+    /// level. Interrupts are only disabled while the pin is low for each pulse
+    /// (about 1 &micro;s, plus the time to write the pin), so they are not
+    /// delayed by more than that. On AVR-based boards, the pin is written
+    /// directly through its I/O port register.
+    ///
+    /// The object must remain valid until this function is called again.
+    void setDimmer(QTRDimmer * dimmer) { _dimmer = dimmer; }
+
+    /// \brief Returns the object that generates the dimming pulses.
+    ///
+    /// \return The pointer passed to setDimmer(), or `nullptr` if the pulses
+    /// are generated in software.
+    QTRDimmer * getDimmer() { return _dimmer; }
+
     /// \brief Returns the dimming level.
     ///
     /// \return The dimming level.
@@ -319,6 +978,68 @@ class QTRSensors
     /// See also setDimmingLevel().
     uint8_t getDimmingLevel() { return _dimmingLevel; }
 
+    /// \brief Sets whether the off readings are taken first in the
+    /// QTRReadMode::OnAndOff and QTRReadMode::OddEvenAndOff modes.
+    ///
+    /// \param offFirst If true, read() takes the readings with the emitters off
+    /// before the readings with them on. The default is false, which takes
+    /// the off readings last.
+    ///
+    /// The emitters are already off at the start of each read, so taking the
+    /// off readings first avoids waiting for the emitters to turn off in the
+    /// middle of the read (1.2 ms for dimmable sensors, 200 &micro;s
+    /// otherwise). Instead, the emitters are turned off at the end of the read
+    /// without waiting, and the next read only waits for whatever part of that
+    /// time has not already passed. The values returned are calculated the
+    /// same way in either order.
+    ///
+    /// This setting only applies to the QTRReadMode::OnAndOff and
+    /// QTRReadMode::OddEvenAndOff modes.
+    void setOffFirst(bool offFirst) { _offFirst = offFirst; }
+
+    /// \brief Returns whether the off readings are taken first.
+    ///
+    /// \return True if the off readings are taken before the on readings,
+    /// false otherwise.
+    ///
+    /// See also setOffFirst().
+    bool getOffFirst() { return _offFirst; }
+
+    /// \brief Sets how often new off readings are taken in the
+    /// QTRReadMode::OnAndOff and QTRReadMode::OddEvenAndOff modes.
+    ///
+    /// \param interval The number of reads that use each set of off readings.
+    /// The default is 1, which takes new off readings for every read.
+    ///
+    /// Ambient light usually changes much more slowly than a control loop
+    /// reads the sensors. With an interval greater than 1, the off readings
+    /// are stored in this object (allocating memory for them if needed) and
+    /// reused for the following reads, which then only need to read the
+    /// sensors with the emitters on. This makes most of those reads nearly
+    /// twice as fast.
+    ///
+    /// The library cannot tell when ambient light changes without taking new
+    /// off readings, so if your application knows that it has (for example,
+    /// because the robot has moved into a different area), call
+    /// invalidateOffValues() to make the next read take new ones.
+    ///
+    /// This setting only applies to the QTRReadMode::OnAndOff and
+    /// QTRReadMode::OddEvenAndOff modes.
+    void setOffRefreshInterval(uint8_t interval);
+
+    /// \brief Returns how often new off readings are taken.
+    ///
+    /// \return The number of reads that use each set of off readings.
+    ///
+    /// See also setOffRefreshInterval().
+    uint8_t getOffRefreshInterval() { return _offRefreshInterval; }
+
+    /// \brief Makes the next read take new off readings.
+    ///
+    /// See setOffRefreshInterval(). Changing the sensor type, pins, timeout,
+    /// or samples per sensor also does this automatically.
+    void invalidateOffValues() { _offValuesValid = false; }
+
     /// \brief Turns the IR LEDs off.
     ///
     /// \param emitters Which emitters to turn off, as a member of the
@@ -354,6 +1075,18 @@ class QTRSensors
     /// emitters alone.
     void emittersOn(QTREmitters emitters = QTREmitters::All, bool wait = true);
 
+    /// \brief Updates the library's record of whether the emitters are on.
+    ///
+    /// To avoid reading the emitter pins every time it turns the emitters on
+    /// or off, this library remembers the state it last set them to. If your
+    /// code changes the emitter pins without going through this library (for
+    /// example, by calling `digitalWrite()` on them while using
+    /// QTRReadMode::Manual), call this function afterward so that
+    /// emittersOn(), emittersOff(), and read() know their actual states.
+    ///
+    /// setEmitterPin() and setEmitterPins() call this function automatically.
+    void syncEmitterState();
+
     /// \brief Turns on the selected emitters and turns off the other emitters
     /// with optimized timing.
     ///
@@ -369,6 +1102,72 @@ class QTRSensors
     /// states before returning.
     void emittersSelect(QTREmitters emitters);
 
+    /// \brief Turns the emitters on and keeps them on for QTRReadMode::On
+    /// reads until endEmitterSession() is called.
+    ///
+    /// Normally, each QTRReadMode::On read turns the emitters on, waits for
+    /// them to settle (and, for dimmable sensors, turns them off and back on
+    /// to apply the dimming level), and turns them off again afterward,
+    /// waiting for them to turn off. When you take many readings in a row,
+    /// you can call this function once to turn the emitters on and apply the
+    /// dimming level, then take any number of readings with read(),
+    /// readCalibrated(), readLineBlack(), or readLineWhite() in
+    /// QTRReadMode::On without the emitters being switched between them.
+    ///
+    /// Reads in other modes still control the emitters as usual during a
+    /// session, and the next QTRReadMode::On read turns the emitters back on
+    /// if needed. A new dimming level set with setDimmingLevel() takes effect
+    /// when the emitters are turned on again, not during the session.
+    ///
+    /// See also QTREmitterSession, which ends the session automatically.
+    void beginEmitterSession();
+
+    /// \brief Ends a session started with beginEmitterSession() and turns the
+    /// emitters off.
+    ///
+    /// \param wait If true (the default), this function delays to give the
+    /// sensors time to turn off before returning. Otherwise, it returns
+    /// immediately.
+    void endEmitterSession(bool wait = true);
+
+    /// \brief Returns whether an emitter session is active.
+    ///
+    /// \return True if beginEmitterSession() has been called without a
+    /// matching call to endEmitterSession(), false otherwise.
+    bool isEmitterSessionActive() { return _emitterSession; }
+
+#if QTR_TIMING_STATS
+    /// \brief Returns the timing statistics for a phase of reading the
+    /// sensors.
+    ///
+    /// \param phase The phase, as a member of the ::QTRPhase enum.
+    ///
+    /// \return The statistics recorded since this object was created or
+    /// resetPhaseStats() was called.
+    ///
+    /// The library records how long each phase of a reading takes (measured
+    /// with `micros()`) every time it happens, so a phase can be recorded
+    /// several times per reading; for example, an QTRReadMode::OddEven reading
+    /// of RC sensors includes two discharge phases. Phases of reads made with
+    /// startRead() and poll() are recorded too, except that the emitter
+    /// settling time is not waited for inside emittersOn() or emittersOff()
+    /// in that case.
+    ///
+    /// This function is only available if QTR_TIMING_STATS is defined as 1
+    /// when the library is compiled; otherwise, no timing code is compiled
+    /// in. If you read sensors in an interrupt (for example, with
+    /// QTRAcquisition), disable interrupts while copying the statistics.
+    const QTRPhaseStats & getPhaseStats(QTRPhase phase)
+    {
+      return _phaseStats[(uint8_t)phase];
+    }
+
+    /// \brief Clears the timing statistics for all phases.
+    ///
+    /// See getPhaseStats().
+    void resetPhaseStats();
+#endif
+
     /// \brief Reads the sensors for calibration.
     ///
     /// \param mode The emitter behavior during calibration, as a member of the
@@ -391,6 +1190,13 @@ class QTRSensors
     /// setSensorPins(), and they will only be allocated when calibrate() is
     /// called. If you only calibrate with the emitters on, the calibration
     /// arrays that hold the off values will not be allocated (and vice versa).
+    /// If a buffer has been set with setBuffer(), the arrays are stored in
+    /// the buffer instead of being allocated, and the buffer must include
+    /// QTRBufferCalibration.
+    ///
+    /// While it runs, this method also needs room for three values per
+    /// sensor, which it allocates for the duration of the call (or takes
+    /// from the buffer).
     ///
     /// See \ref md_usage for more information and example code.
     void calibrate(QTRReadMode mode = QTRReadMode::On);
@@ -398,6 +1204,29 @@ class QTRSensors
     /// \brief Resets all calibration that has been done.
     void resetCalibration();
 
+    /// \brief Tells the library that the calibration data has been changed
+    /// directly.
+    ///
+    /// For the QTRReadMode::OnAndOff and QTRReadMode::OddEvenAndOff modes,
+    /// readCalibrated() combines the on and off calibration values once and
+    /// keeps the result. calibrate() and resetCalibration() update it
+    /// automatically, but if you write to the arrays in #calibrationOn or
+    /// #calibrationOff yourself (for example, to restore calibration values
+    /// saved in EEPROM), call this function afterward so that the next
+    /// reading in those modes uses the new values.
+    ///
+    /// Example usage:
+    /// ~~~{.cpp}
+    /// qtr.calibrate(QTRReadMode::OnAndOff); // allocates the arrays
+    /// for (uint8_t i = 0; i < SensorCount; i++)
+    /// {
+    ///   qtr.calibrationOn.minimum[i] = savedOnMinimum[i];
+    ///   // ...
+    /// }
+    /// qtr.invalidateCalibrationCache();
+    /// ~~~
+    void invalidateCalibrationCache() { _calibrationCombined.initialized = false; }
+
     /// \brief Reads the raw sensor values into an array.
     ///
     /// \param[out] sensorValues A pointer to an array in which to store the
@@ -418,12 +1247,19 @@ class QTRSensors
     /// surface or a void).
     ///
     /// Analog sensors will return a raw value between 0 and 1023 (like
-    /// Arduino's `analogRead()` function).
+    /// Arduino's `analogRead()` function), or a wider range if set with
+    /// setAnalogResolution() or setOversampling().
     ///
     /// RC sensors will return a raw value in microseconds between 0 and the
     /// timeout setting configured with setTimeout() (the default timeout is
     /// 2500 &micro;s).
     ///
+    /// The QTRReadMode::OnAndOff and QTRReadMode::OddEvenAndOff modes store
+    /// the off readings in this object, allocating memory for them the first
+    /// time. If the memory cannot be allocated (or the buffer set with
+    /// setBuffer() does not include QTRBufferOffValues), this function
+    /// returns without reading and \p sensorValues is not changed.
+    ///
     /// See \ref md_usage for more information and example code.
     void read(uint16_t * sensorValues, QTRReadMode mode = QTRReadMode::On);
 
@@ -444,9 +1280,215 @@ class QTRSensors
     /// calibrate(), and they are stored separately for each sensor, so that
     /// differences in the sensors are accounted for automatically.
     ///
+    /// If the sensors have not been calibrated in \p mode, or read() could
+    /// not read in it, this function returns without reading and
+    /// \p sensorValues is not changed.
+    ///
     /// See \ref md_usage for more information and example code.
     void readCalibrated(uint16_t * sensorValues, QTRReadMode mode = QTRReadMode::On);
 
+    /// \brief Reads the raw values of some of the sensors.
+    ///
+    /// \param[out] sensorValues A pointer to an array in which to store the
+    /// raw sensor readings. There **MUST** be space in the array for as many
+    /// values as there were sensors specified in setSensorPins().
+    ///
+    /// \param mask The sensors to read, as an array of (n + 7) / 8 bytes for
+    /// n sensors: bit 0 (the least significant bit) of the first byte selects
+    /// the first sensor, bit 1 the second, and so on up to bit 7 of that byte
+    /// for the eighth sensor, and then the second byte selects the next eight
+    /// sensors. The bits of the last byte for sensors that don't exist are
+    /// ignored.
+    ///
+    /// \param mode The emitter behavior during the read, as a member of the
+    /// ::QTRReadMode enum. The default is QTRReadMode::On.
+    ///
+    /// This works like read(), but only the selected sensors are charged,
+    /// timed, or converted, and the entries of \p sensorValues for the other
+    /// sensors are left unchanged. Reading only the sensors you need (for
+    /// example, the ones near the center of the array) makes each read
+    /// faster. With separate odd and even emitter control pins, only the
+    /// emitters needed by the selected sensors are turned on.
+    ///
+    /// Example usage:
+    /// ~~~{.cpp}
+    /// uint16_t sensorValues[8];
+    /// // read the middle four sensors
+    /// const uint8_t middle[] = {0b00111100};
+    /// qtr.readMasked(sensorValues, middle);
+    /// ~~~
+    ///
+    /// In the QTRReadMode::OnAndOff and QTRReadMode::OddEvenAndOff modes,
+    /// masked reads always take new off readings, and the off readings are not
+    /// reused by the next read (see setOffRefreshInterval()).
+    void readMasked(uint16_t * sensorValues, const uint8_t * mask,
+                    QTRReadMode mode = QTRReadMode::On);
+
+    /// \brief Reads some of the sensors and provides calibrated values
+    /// between 0 and 1000.
+    ///
+    /// \param[out] sensorValues A pointer to an array in which to store the
+    /// calibrated sensor readings. There **MUST** be space in the array for
+    /// as many values as there were sensors specified in setSensorPins().
+    ///
+    /// \param mask The sensors to read, as for readMasked().
+    ///
+    /// \param mode The emitter behavior during the read, as a member of the
+    /// ::QTRReadMode enum. The default is QTRReadMode::On. Manual emitter
+    /// control with QTRReadMode::Manual is not supported.
+    ///
+    /// This works like readCalibrated(), but only the selected sensors are
+    /// read and calibrated, and the entries of \p sensorValues for the other
+    /// sensors are left unchanged.
+    void readCalibratedMasked(uint16_t * sensorValues, const uint8_t * mask,
+                              QTRReadMode mode = QTRReadMode::On);
+
+    /// \brief Starts reading the raw sensor values without blocking.
+    ///
+    /// \param[out] sensorValues A pointer to an array in which to store the
+    /// raw sensor readings. There **MUST** be space in the array for as many
+    /// values as there were sensors specified in setSensorPins(), and the
+    /// array must stay valid until the read is finished.
+    ///
+    /// \param mode The emitter behavior during the read, as a member of the
+    /// ::QTRReadMode enum. The default is QTRReadMode::On.
+    ///
+    /// This method takes the same readings as read(), but instead of waiting
+    /// for the emitters to turn on and off and for the sensors to be read, it
+    /// returns immediately. Call poll() repeatedly (for example, once per
+    /// iteration of your main loop) to carry out the read; poll() returns
+    /// true, and isReady() starts returning true, once the values in \p
+    /// sensorValues are complete.
+    ///
+    /// Example usage:
+    /// ~~~{.cpp}
+    /// uint16_t sensorValues[8];
+    ///
+    /// void loop()
+    /// {
+    ///   if (qtr.poll())
+    ///   {
+    ///     // use sensorValues here, then start the next read
+    ///     qtr.startRead(sensorValues);
+    ///   }
+    ///
+    ///   // do other work here
+    /// }
+    /// ~~~
+    ///
+    /// Note that the timing of RC readings depends on how often poll() is
+    /// called: each call checks the sensors once, so a sensor that discharges
+    /// between two calls is recorded at the time of the second call. Analog
+    /// readings are taken one sample per sensor per call, and poll() waits for
+    /// those conversions to complete.
+    ///
+    /// If a read is still in progress, this method first abandons it with
+    /// cancelRead(), which releases its RC lines and interrupts but leaves the
+    /// emitters as they are. Do not call any of the other read methods or
+    /// calibrate() while a read started with this method is in progress.
+    ///
+    /// \return True if the read was started, or false if it could not be
+    /// because memory for the off readings of the QTRReadMode::OnAndOff or
+    /// QTRReadMode::OddEvenAndOff mode could not be allocated (or the buffer
+    /// set with setBuffer() does not include QTRBufferOffValues). In that case,
+    /// poll() returns true right away and \p sensorValues is not changed.
+    bool startRead(uint16_t * sensorValues, QTRReadMode mode = QTRReadMode::On);
+
+    /// \brief Starts reading calibrated sensor values without blocking.
+    ///
+    /// \param[out] sensorValues A pointer to an array in which to store the
+    /// calibrated sensor readings. There **MUST** be space in the array for
+    /// as many values as there were sensors specified in setSensorPins(), and
+    /// the array must stay valid until the read is finished.
+    ///
+    /// \param mode The emitter behavior during the read, as a member of the
+    /// ::QTRReadMode enum. The default is QTRReadMode::On. Manual emitter
+    /// control with QTRReadMode::Manual is not supported.
+    ///
+    /// \return True if the read was started, or false if it could not be
+    /// (see startRead()) or the sensors have not been calibrated for \p mode.
+    ///
+    /// This is the non-blocking version of readCalibrated(); see startRead()
+    /// for details. If the read could not be started, it finishes immediately
+    /// without changing \p sensorValues.
+    bool startReadCalibrated(uint16_t * sensorValues, QTRReadMode mode = QTRReadMode::On);
+
+    /// \brief Starts reading the raw values of some of the sensors without
+    /// blocking.
+    ///
+    /// \param[out] sensorValues As for startRead().
+    ///
+    /// \param mask The sensors to read, as for readMasked(). Like
+    /// \p sensorValues, the array must stay valid until the read is finished.
+    ///
+    /// \param mode The emitter behavior during the read, as a member of the
+    /// ::QTRReadMode enum. The default is QTRReadMode::On.
+    ///
+    /// \return True if the read was started, or false if it could not be (see
+    /// startRead()) or \p mask does not select any sensors.
+    ///
+    /// This is the non-blocking version of readMasked(); see startRead() for
+    /// details. Only the selected sensors are read, and the entries of \p
+    /// sensorValues for the other sensors are left unchanged.
+    bool startReadMasked(uint16_t * sensorValues, const uint8_t * mask,
+                         QTRReadMode mode = QTRReadMode::On);
+
+    /// \brief Starts reading calibrated values of some of the sensors without
+    /// blocking.
+    ///
+    /// \param[out] sensorValues As for startReadCalibrated().
+    ///
+    /// \param mask The sensors to read, as for readMasked(). Like
+    /// \p sensorValues, the array must stay valid until the read is finished.
+    ///
+    /// \param mode The emitter behavior during the read, as a member of the
+    /// ::QTRReadMode enum. The default is QTRReadMode::On. Manual emitter
+    /// control with QTRReadMode::Manual is not supported.
+    ///
+    /// \return True if the read was started, or false if it could not be (see
+    /// startReadCalibrated()) or \p mask does not select any sensors.
+    ///
+    /// This is the non-blocking version of readCalibratedMasked(); see
+    /// startRead() for details.
+    bool startReadCalibratedMasked(uint16_t * sensorValues,
+                                   const uint8_t * mask,
+                                   QTRReadMode mode = QTRReadMode::On);
+
+    /// \brief Advances a read started with startRead() or
+    /// startReadCalibrated().
+    ///
+    /// \return True if the read is finished, false otherwise.
+    ///
+    /// This method does as much of the read as it can without waiting, then
+    /// returns. Once the read is finished, further calls return true without
+    /// doing anything until another read is started.
+    bool poll();
+
+    /// \brief Returns whether a read started with startRead() or
+    /// startReadCalibrated() is finished.
+    ///
+    /// \return True if the read is finished, false if it is still in
+    /// progress or no read has been started.
+    ///
+    /// Unlike poll(), this method does not advance the read.
+    bool isReady()
+    {
+      return (_readState == ReadState::Done) || (_readState == ReadState::Failed);
+    }
+
+    /// \brief Abandons a read started with startRead() or
+    /// startReadCalibrated().
+    ///
+    /// This stops the read right away, wherever it is: RC sensor lines that
+    /// are being charged are released, and any pin interrupts or ADC interrupt
+    /// the read is using are given up, so that another object (or your own
+    /// code) can use them. The emitters are left as they are, so call
+    /// emittersOff() afterward if needed. The values in the array passed to
+    /// startRead() are incomplete.
+    ///
+    /// Calling this when no read is in progress does nothing.
+    void cancelRead();
+
     /// \brief Reads the sensors, provides calibrated values, and returns an
     /// estimated black line position.
     ///
@@ -488,7 +1530,7 @@ class QTRSensors
     /// readLineWhite().
     ///
     /// See \ref md_usage for more information and example code.
-    uint16_t readLineBlack(uint16_t * sensorValues, QTRReadMode mode = QTRReadMode::On)
+    QTRPosition readLineBlack(uint16_t * sensorValues, QTRReadMode mode = QTRReadMode::On)
     {
       return readLinePrivate(sensorValues, mode, false);
     }
@@ -511,7 +1553,7 @@ class QTRSensors
     /// readLineBlack().
     ///
     /// See \ref md_usage for more information and example code.
-    uint16_t readLineWhite(uint16_t * sensorValues, QTRReadMode mode = QTRReadMode::On)
+    QTRPosition readLineWhite(uint16_t * sensorValues, QTRReadMode mode = QTRReadMode::On)
     {
       return readLinePrivate(sensorValues, mode, true);
     }
@@ -537,6 +1579,9 @@ class QTRSensors
     /// These variables are made public so that you can use them for your own
     /// calculations and do things like saving the values to EEPROM, performing
     /// sanity checking, etc.
+    ///
+    /// If you change the values in these arrays yourself, call
+    /// invalidateCalibrationCache() afterward.
     /// \{
 
     /// Data from calibrating with emitters on.
@@ -549,31 +1594,885 @@ class QTRSensors
 
   private:
 
-    uint16_t emittersOnWithPin(uint8_t pin);
+    template <uint8_t Capacity, uint8_t Features> friend class ::QTRBuffer;
+    template <QTRType Type, uint8_t... Pins> friend class ::QTRSensorsT;
+    friend class ::QTRSensorGroup;
+
+    // Progress of a read started with startRead().
+    enum class ReadState : uint8_t {
+      Idle,
+      Emitters, // switching the emitters for the next pass
+      Settling, // waiting for the emitters to settle
+      Scanning, // reading the sensors
+      Done,
+      Failed // finished without reading (see startRead())
+    };
+
+    // One pass of a read; see getReadPass().
+    struct ReadPass
+    {
+      QTREmitters emitters;
+      bool controlEmitters;
+      bool settle; // whether to wait for the emitters before continuing
+      uint8_t start;
+      uint8_t step;
+      bool off; // whether to store the readings as off values
+    };
+
+#if defined(__AVR__)
+    typedef uint8_t PortMask;
+#else
+    typedef uint32_t PortMask;
+#endif
+
+    // An I/O port that one or more sensor pins belong to.
+    struct SensorPort
+    {
+      const volatile PortMask * input;
+      // bits of the sensors on this port that have not discharged yet
+      PortMask pending;
+    };
+
+    // The port and bit that a sensor pin corresponds to.
+    struct SensorBit
+    {
+      uint8_t port; // index into _sensorPorts
+      PortMask mask;
+    };
+
+    // The samples of one sensor kept for a QTRSampleReduction other than
+    // QTRSampleReduction::Mean.
+    struct SampleSet
+    {
+      uint16_t values[QTRMaxSortedSamples];
+    };
+
+    // Multiplier for converting readings to calibrated values, cached along
+    // with the calibration range (denominator) it was computed for.
+    struct CalibrationScale
+    {
+      uint16_t denominator;
+      uint32_t multiplier; // (1000 << 22) / denominator, rounded up
+    };
+
+    // The cached multipliers of one sensor, one for each calibration that
+    // readCalibrated() uses (on, off, and combined on/off), so that
+    // alternating between read modes does not recompute them.
+    struct CalibrationScales
+    {
+      CalibrationScale calibration[3]; // on, off, combined
+    };
+
+    uint16_t emittersOnWithPin(uint8_t pin, bool & pinOn);
+
+#if QTR_TIMING_STATS
+    // Records the time since [start] (from micros()) for [phase].
+    void recordPhase(QTRPhase phase, uint16_t start);
+
+    // Records the time from its construction to its destruction for a phase.
+    class PhaseTimer
+    {
+      public:
+        PhaseTimer(QTRSensors & sensors, QTRPhase phase);
+        ~PhaseTimer() { _sensors.recordPhase(_phase, _start); }
+
+      private:
+        QTRSensors & _sensors;
+        QTRPhase _phase;
+        uint16_t _start;
+    };
+#endif
+    void sendDimmingPulses(uint8_t pin);
+
+    void addEmitterSettleTime(uint16_t start, uint16_t time);
+
+    bool emittersSettled();
 
     // Handles the actual calibration, including (re)allocating and
     // initializing the storage for the calibration values if necessary.
     void calibrateOnOrOff(CalibrationData & calibration, QTRReadMode mode);
 
+    template <typename T>
+    bool allocateArray(T * & array, uint8_t count);
+
+    // Arrays that are not part of the buffer are passed as nullptr.
+    void useBuffer(uint8_t * pins, SensorBit * sensorBits,
+                   SensorPort * sensorPorts, uint16_t * calibration,
+                   uint16_t * calibrationCombined,
+                   CalibrationScales * calibrationScales,
+                   uint16_t * offValues, uint32_t * analogSums,
+                   SampleSet * sampleSets, uint8_t capacity);
+
+    void freeArrays();
+
+    void sensorPinsChanged(uint8_t sensorCount);
+    void analogScaleChanged();
+
+    // Groups the sensor pins by I/O port for polling RC sensors.
+    void groupSensorPorts();
+
+    bool allocateOffValues(QTRReadMode mode);
+    bool offValuesNeeded();
+    bool isCalibrated(QTRReadMode mode);
+
+    void combineOffValues(uint16_t * sensorValues, const uint16_t * offValues);
+
+    void getCombinedCalibration(uint8_t i, uint16_t & calmin, uint16_t & calmax);
+
+    void updateCombinedCalibration();
+
+    void applyCalibration(uint16_t * sensorValues, QTRReadMode mode);
+
+    bool startReadPrivate(uint16_t * sensorValues, QTRReadMode mode, bool calibrated);
+
+    bool getReadPass(QTRReadMode mode, bool offFirst, bool readOff,
+                     uint8_t pass, ReadPass & readPass);
+
+
     void readPrivate(uint16_t * sensorValues, uint8_t start = 0, uint8_t step = 1);
 
-    uint16_t readLinePrivate(uint16_t * sensorValues, QTRReadMode mode, bool invertReadings);
+    // Lets readPrivate() read through the scan when the settings need it. The
+    // scan is only linked into sketches that call this (through the methods
+    // that enable its features) or read with startRead() and poll().
+    void useScan() { _scanReader = scanRead; }
+    bool scanNeeded();
+    static void scanRead(QTRSensors & sensors, uint16_t * sensorValues,
+                         uint8_t start, uint8_t step);
+
+    bool startScan(uint16_t * sensorValues, uint8_t start, uint8_t step);
+
+    // Releases the interrupts used by the scan in progress, if any.
+    void stopScan()
+    {
+      if (_scanRelease != nullptr) { _scanRelease(*this); }
+    }
+    static void releaseScan(QTRSensors & sensors);
+
+    bool continueScan();
+
+    // Returns whether sensor [i] is included in the read in progress by the
+    // mask of a masked read.
+    bool readIncludes(uint8_t i)
+    {
+      return !_readMasked || ((_readMask[i >> 3] >> (i & 7)) & 1);
+    }
+
+    // Returns the index of the next sensor in the scan in progress after [i],
+    // or _sensorCount if there is none.
+    uint8_t nextScanSensor(uint8_t i)
+    {
+      do { i += _scanStep; } while ((i < _sensorCount) && !readIncludes(i));
+      return i;
+    }
+
+    bool beginMaskedRead(const uint8_t * mask);
+    bool readSelects(uint8_t start, uint8_t step);
+    QTREmitters maskEmitters();
+
+    // Used by analog scans to add up conversions and finish the samples.
+    void addConversion(uint8_t index, uint16_t value, uint16_t conversion);
+    uint16_t reduceSamples(uint16_t * samples);
+    static void sortSamples(uint16_t * samples, uint8_t count);
+
+    bool attachSensorInterrupts();
+
+    void detachSensorInterrupts();
+
+#if QTR_PCINT_INTERRUPTS
+    // Called from the pin change interrupt handlers.
+    void recordPinChanges();
+#elif !defined(__AVR__)
+    // Called from the interrupt handler for sensor [index].
+    void recordDischarge(uint8_t index);
+
+    template <uint8_t Index>
+    static void sensorInterrupt();
+
+    // RC timing with interrupts is only supported for up to this many sensors.
+    static const uint8_t InterruptSensorCount = 31;
+
+    // interrupt handlers for each sensor index
+    static void (* const _sensorInterrupts[InterruptSensorCount])();
+#endif
+
+    // the object whose sensor interrupts are attached, if any
+    static QTRSensors * volatile _interruptSensors;
+
+#if QTR_ADC_INTERRUPTS
+    // Starts interrupt-driven conversions for the analog scan started by
+    // startScan(). Returns false if they cannot be used.
+    bool startAdcScan();
+    void stopAdcScan();
+
+    // Called from the ADC interrupt handler.
+    void recordConversion();
+
+    static void selectAdcChannel(uint8_t pin);
+
+    // the object whose analog scan is using the ADC interrupt, if any
+    static QTRSensors * volatile _adcSensors;
+#endif
+
+    uint8_t pollSensorPorts(uint16_t * sensorValues, uint16_t time,
+                            uint8_t start, uint8_t step);
+
+    QTRPosition readLinePrivate(uint16_t * sensorValues, QTRReadMode mode, bool invertReadings);
+
+    // Computes the line position from calibrated sensor values.
+    QTRPosition linePosition(const uint16_t * sensorValues, bool invertReadings);
 
     QTRType _type = QTRType::Undefined;
 
     uint8_t * _sensorPins = nullptr;
     uint8_t _sensorCount = 0;
 
+    // capacity of the buffer set with setBuffer() (0 if arrays are allocated
+    // on the heap)
+    uint8_t _bufferCapacity = 0;
+
+    // Port grouping of the sensor pins (_sensorPortCount is 0 if
+    // QTR_PORT_POLLING is disabled or the pins could not be grouped).
+    SensorBit * _sensorBits = nullptr;
+    SensorPort * _sensorPorts = nullptr;
+    uint8_t _sensorPortCount = 0;
+
     uint16_t _timeout = QTRRCDefaultTimeout; // only used for RC sensors
+    bool _earlyExit = false; // only used for RC sensors
+    bool _offFirst = false;
+    uint8_t _offRefreshInterval = 1;
+    QTRRCTiming _rcTiming = QTRRCTiming::Polled;
+    QTRAnalogTiming _analogTiming = QTRAnalogTiming::Blocking;
+    bool _adcReferenceSet = false; // only used for analog sensors
     uint16_t _maxValue = QTRRCDefaultTimeout; // the maximum value returned by readPrivate()
     uint8_t _samplesPerSensor = 4; // only used for analog sensors
+    uint8_t _analogResolution = 10; // only used for analog sensors
+    uint8_t _oversampling = 0; // only used for analog sensors
+    QTRSampleReduction _sampleReduction = QTRSampleReduction::Mean; // only used for analog sensors
+    QTRSampleOrder _sampleOrder = QTRSampleOrder::Interleaved; // only used for analog sensors
 
     uint8_t _oddEmitterPin = QTRNoEmitterPin; // also used for single emitter pin
     uint8_t _evenEmitterPin = QTRNoEmitterPin;
+    bool _oddEmitterOn = false; // tracked states of the emitter pins; see
+    bool _evenEmitterOn = false; // syncEmitterState()
+    bool _emitterSession = false;
     uint8_t _emitterPinCount = 0;
 
     bool _dimmable = true;
     uint8_t _dimmingLevel = 0;
+    QTRDimmer * _dimmer = nullptr;
+
+    QTRPosition _lastPosition = 0;
+
+    // used by readCalibrated()
+    CalibrationData _calibrationCombined; // for OnAndOff and OddEvenAndOff
+    CalibrationScales * _calibrationScales = nullptr;
+    bool _calibrationScalesInitialized = false;
+
+    // working storage for calibrate() in the buffer set with setBuffer()
+    // (allocated during each call otherwise)
+    uint16_t * _calibrationScratch = nullptr;
+
+    // when the emitters were last switched and how long they need to settle
+    uint32_t _emitterSettleStart = 0;
+    uint16_t _emitterSettleTime = 0;
+
+    // set by useScan() and startScan() respectively, so that readPrivate()
+    // and stopScan() do not link the scan into sketches that don't use it
+    void (* _scanReader)(QTRSensors &, uint16_t *, uint8_t, uint8_t) = nullptr;
+    void (* _scanRelease)(QTRSensors &) = nullptr;
+
+    // What readPrivate() asks _rcLines to do with the RC sensor lines it is
+    // reading.
+    enum class RCLineAction : uint8_t {
+      Charge, // drive the lines high
+      Release, // make the lines inputs; returns how many were released
+      Poll // record the time for lines that have gone low; returns how many did
+    };
+
+    // Set by QTRSensorsT to access the RC sensor lines through the port
+    // registers with the ports and bits known at compile time, in place of
+    // pinMode() and port polling (or digitalRead()).
+    uint8_t (* _rcLines)(RCLineAction action, uint16_t * sensorValues,
+                         uint16_t time, uint8_t start, uint8_t step) = nullptr;
+
+    // state of the sensor scan in progress (see startScan())
+    uint16_t * _scanValues = nullptr;
+    uint32_t _scanSum = 0; // analog only: sum of the current sensor in a burst
+    bool _scanBurst = false; // analog only: whether each sensor's conversions are taken together
+    bool _scanWideSums = false; // analog only: whether the sums are kept in _analogSums
+    bool _scanKeepSamples = false; // analog only: whether the samples are kept in _sampleSets
+    uint16_t _scanConversions = 0; // analog only: conversions per sensor
+    uint16_t _scanConversionsTaken = 0; // analog only: rounds (Interleaved) or conversions of the current sensor (Burst)
+    bool _scanDiscard = false; // analog only: whether the next ADC interrupt result is discarded
+    uint16_t _scanStartTime = 0; // when RC lines started charging/discharging, or analog sampling started
+    uint8_t _scanStart = 0;
+    uint8_t _scanStep = 1;
+    volatile uint8_t _scanCount = 0; // RC only: sensors not discharged
+    volatile bool _scanDischarging = false; // RC only
+    bool _scanInterrupts = false; // RC only: whether pin interrupts are attached
+    bool _scanAdc = false; // analog only: whether the ADC interrupt is in use
+    volatile uint8_t _scanIndex = 0; // analog only: sensor being (or next to be) converted
+
+    // state of the read started with startRead()
+    ReadState _readState = ReadState::Idle;
+    QTRReadMode _readMode = QTRReadMode::On;
+    uint8_t _readPass = 0;
+    bool _readCalibrated = false;
+    bool _readOffFirst = false;
+    bool _readOffValues = false; // whether the current read takes off readings
+    bool _readMasked = false; // set during masked reads
+    const uint8_t * _readMask = nullptr; // one bit per sensor (see readMasked())
+    uint16_t * _readValues = nullptr;
+    uint16_t * _offValues = nullptr; // only allocated for OnAndOff modes
+    bool _offValuesValid = false; // whether _offValues can be reused
+    uint8_t _offValuesAge = 0; // reads since _offValues were taken
+    uint32_t * _analogSums = nullptr; // only allocated if analog sums need more than 16 bits
+    SampleSet * _sampleSets = nullptr; // only allocated for reductions other than Mean
+
+#if QTR_TIMING_STATS
+    QTRPhaseStats _phaseStats[QTRPhaseCount] = {};
+#endif
+};
+
+QTR_END_CONFIG_NAMESPACE
+
+#if QTR_ADC_INTERRUPTS
+/// \brief Defines the ADC interrupt handler needed by
+/// QTRAnalogTiming::Interrupt.
+///
+/// Use this once, at file scope, in a sketch that uses
+/// QTRSensors::setAnalogTiming() with QTRAnalogTiming::Interrupt. On boards
+/// where that is not supported, it expands to nothing.
+#define QTR_ADC_ISR \
+  extern "C" void qtrAdcIsrDefined() {} \
+  ISR(ADC_vect) { QTRSensors::handleAdcInterrupt(); }
+#else
+#define QTR_ADC_ISR
+#endif
+
+#if QTR_PCINT_INTERRUPTS
+#if QTR_PCINT_VECTORS > 1
+#define QTR_PCINT_ALIASES \
+  ISR(PCINT1_vect, ISR_ALIASOF(PCINT0_vect)); \
+  ISR(PCINT2_vect, ISR_ALIASOF(PCINT0_vect));
+#else
+#define QTR_PCINT_ALIASES
+#endif
+/// \brief Defines the pin change interrupt handlers needed by
+/// QTRRCTiming::Interrupt on AVR-based boards.
+///
+/// Use this once, at file scope, in a sketch that uses
+/// QTRSensors::setRCTiming() with QTRRCTiming::Interrupt. It defines the
+/// handlers for every pin change interrupt vector, so it cannot be used
+/// together with other code that defines any of them. On boards that do not
+/// use pin change interrupts for this, it expands to nothing.
+#define QTR_PCINT_ISR \
+  extern "C" void qtrPcintIsrDefined() {} \
+  ISR(PCINT0_vect) { QTRSensors::handlePinChangeInterrupt(); } \
+  QTR_PCINT_ALIASES
+#else
+#define QTR_PCINT_ISR
+#endif
+
+/// \brief Keeps the emitters of a QTRSensors object on while it exists.
+///
+/// The constructor calls QTRSensors::beginEmitterSession() and the destructor
+/// calls QTRSensors::endEmitterSession(), so the emitters stay on for the
+/// QTRReadMode::On reads made within a block and are turned off when the
+/// block is left.
+///
+/// Example usage:
+/// ~~~{.cpp}
+/// {
+///   QTREmitterSession session(qtr);
+///   for (uint8_t i = 0; i < 10; i++)
+///   {
+///     position = qtr.readLineBlack(sensorValues);
+///     // ...
+///   }
+/// }
+/// ~~~
+class QTREmitterSession
+{
+  public:
+
+    explicit QTREmitterSession(QTRSensors & sensors) : _sensors(sensors)
+    {
+      _sensors.beginEmitterSession();
+    }
+
+    ~QTREmitterSession() { _sensors.endEmitterSession(); }
+
+    QTREmitterSession(const QTREmitterSession &) = delete;
+    QTREmitterSession & operator=(const QTREmitterSession &) = delete;
+
+  private:
+
+    QTRSensors & _sensors;
+};
+
+// An array of Count elements that is only part of a QTRBuffer if Enabled is
+// true; otherwise, it is an empty base class and takes up no space. Id tells
+// apart arrays that would otherwise have the same type.
+template <uint8_t Id, typename T, uint16_t Count, bool Enabled>
+class QTRBufferArray
+{
+  protected:
+
+    T * array() { return _array; }
+
+  private:
+
+    T _array[Count];
+};
+
+template <uint8_t Id, typename T, uint16_t Count>
+class QTRBufferArray<Id, T, Count, false>
+{
+  protected:
+
+    T * array() { return nullptr; }
+};
+
+/// \brief Storage for the arrays used by a QTRSensors object.
+///
+/// \tparam Capacity The maximum number of sensors.
+///
+/// \tparam Features The optional components to include, combined with `|`
+/// (see QTRBufferCalibration and the constants that follow it). The default
+/// is QTRBufferDefault.
+///
+/// See QTRSensors::setBuffer() for details. The contents of this class are
+/// only accessed through the QTRSensors object it is given to.
+///
+/// A buffer always holds the sensor pins (1 byte per sensor), plus the
+/// arrays of the components in \p Features. For example, `QTRBuffer<8>`
+/// takes 176 bytes on an AVR-based board, and `QTRBuffer<8, QTRBufferAll>`
+/// takes 512 bytes.
+template <uint8_t Capacity, uint8_t Features = QTRBufferDefault>
+class QTRBuffer :
+  private QTRBufferArray<0, uint16_t, Capacity * 7,
+                         (Features & QTRBufferCalibration) != 0>,
+  private QTRBufferArray<1, uint16_t, Capacity * 2,
+                         (Features & QTRBufferCalibrationCache) != 0>,
+  private QTRBufferArray<2, QTRSensors::CalibrationScales, Capacity,
+                         (Features & QTRBufferCalibrationCache) != 0>,
+  private QTRBufferArray<3, QTRSensors::SensorBit, Capacity,
+                         (Features & QTRBufferPortPolling) != 0>,
+  private QTRBufferArray<4, QTRSensors::SensorPort, Capacity,
+                         (Features & QTRBufferPortPolling) != 0>,
+  private QTRBufferArray<5, uint16_t, Capacity,
+                         (Features & QTRBufferOffValues) != 0>,
+  private QTRBufferArray<6, uint32_t, Capacity,
+                         (Features & QTRBufferAnalogSums) != 0>,
+  private QTRBufferArray<7, QTRSensors::SampleSet, Capacity,
+                         (Features & QTRBufferSampleSets) != 0>
+{
+  static_assert(Capacity > 0, "The capacity must be at least 1.");
+  static_assert(Capacity <= QTRMaxSensors, "The capacity is too large.");
+  static_assert((Features & ~QTRBufferAll) == 0, "Unknown buffer features.");
+
+  friend QTRSensors;
+
+  // on/off minimum/maximum, and working storage for calibrate()
+  uint16_t * calibration()
+  {
+    return QTRBufferArray<0, uint16_t, Capacity * 7,
+      (Features & QTRBufferCalibration) != 0>::array();
+  }
+
+  // combined minimum/maximum
+  uint16_t * calibrationCombined()
+  {
+    return QTRBufferArray<1, uint16_t, Capacity * 2,
+      (Features & QTRBufferCalibrationCache) != 0>::array();
+  }
+
+  QTRSensors::CalibrationScales * calibrationScales()
+  {
+    return QTRBufferArray<2, QTRSensors::CalibrationScales, Capacity,
+      (Features & QTRBufferCalibrationCache) != 0>::array();
+  }
+
+  QTRSensors::SensorBit * sensorBits()
+  {
+    return QTRBufferArray<3, QTRSensors::SensorBit, Capacity,
+      (Features & QTRBufferPortPolling) != 0>::array();
+  }
+
+  QTRSensors::SensorPort * sensorPorts()
+  {
+    return QTRBufferArray<4, QTRSensors::SensorPort, Capacity,
+      (Features & QTRBufferPortPolling) != 0>::array();
+  }
+
+  uint16_t * offValues()
+  {
+    return QTRBufferArray<5, uint16_t, Capacity,
+      (Features & QTRBufferOffValues) != 0>::array();
+  }
+
+  uint32_t * analogSums()
+  {
+    return QTRBufferArray<6, uint32_t, Capacity,
+      (Features & QTRBufferAnalogSums) != 0>::array();
+  }
+
+  QTRSensors::SampleSet * sampleSets()
+  {
+    return QTRBufferArray<7, QTRSensors::SampleSet, Capacity,
+      (Features & QTRBufferSampleSets) != 0>::array();
+  }
+
+  uint8_t _pins[Capacity];
+};
+
+template <uint8_t Capacity, uint8_t Features>
+void QTRSensors::setBuffer(QTRBuffer<Capacity, Features> & buffer)
+{
+  useBuffer(buffer._pins, buffer.sensorBits(), buffer.sensorPorts(),
+            buffer.calibration(), buffer.calibrationCombined(),
+            buffer.calibrationScales(), buffer.offValues(),
+            buffer.analogSums(), buffer.sampleSets(), Capacity);
+}
+
+/// \brief Represents a QTR sensor array that stores its arrays inside the
+/// object instead of on the heap.
+///
+/// \tparam Capacity The maximum number of sensors.
+///
+/// \tparam Features The optional components of the buffer, as for QTRBuffer.
+/// The default is QTRBufferDefault.
+///
+/// This class works like QTRSensors, but it contains a QTRBuffer that is set
+/// with setBuffer() when it is constructed, so it never allocates memory on
+/// the heap.
+///
+/// Example usage:
+/// ~~~{.cpp}
+/// QTRSensorsFixed<8> qtr;
+/// ~~~
+template <uint8_t Capacity, uint8_t Features = QTRBufferDefault>
+class QTRSensorsFixed : public QTRSensors
+{
+  public:
+
+    QTRSensorsFixed() { setBuffer(_buffer); }
+
+  private:
+
+    QTRBuffer<Capacity, Features> _buffer;
+};
+
+#if QTR_PIN_TABLES
+
+// for the port registers
+#include <Arduino.h>
+
+/// \brief The I/O port and bit of each digital pin of the Arduino boards
+/// based on this microcontroller, for QTRSensorsT.
+///
+/// The Arduino core keeps this information in program memory, where it can
+/// only be read at run time. This copy can be used in constant expressions.
+/// The ports are numbered as by `digitalPinToPort()`.
+struct QTRPinTable
+{
+  /// Returns the port of a pin, or 0 (`NOT_A_PORT`) if there is no such
+  /// digital pin.
+  static constexpr uint8_t port(uint8_t pin)
+  {
+    return (pin < sizeof(Entries)) ? (Entries[pin] >> 4) : 0;
+  }
+
+  /// Returns the bit mask of a pin within its port.
+  static constexpr uint8_t mask(uint8_t pin)
+  {
+    return 1 << (Entries[pin] & 7);
+  }
+
+  // Each entry is the port times 16 plus the bit.
+  static constexpr uint8_t Entries[] = {
+#if defined(__AVR_ATmega168__) || defined(__AVR_ATmega328P__)
+    // D0-D7: PD0-PD7, D8-D13: PB0-PB5, D14-D19 (A0-A5): PC0-PC5
+    0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47,
+    0x20, 0x21, 0x22, 0x23, 0x24, 0x25,
+    0x30, 0x31, 0x32, 0x33, 0x34, 0x35,
+#elif defined(__AVR_ATmega32U4__)
+    // D0-D17
+    0x42, 0x43, 0x41, 0x40, 0x44, 0x36, 0x47, 0x56,
+    0x24, 0x25, 0x26, 0x27, 0x46, 0x37, 0x23, 0x21, 0x22, 0x20,
+    // D18-D23 (A0-A5)
+    0x67, 0x66, 0x65, 0x64, 0x61, 0x60,
+    // D24-D29 (A6-A11, the same pins as D4, D6, D8, D9, D10, and D12), D30
+    0x44, 0x47, 0x24, 0x25, 0x26, 0x46, 0x45,
+#else // ATmega1280 and ATmega2560
+    // D0-D21
+    0x50, 0x51, 0x54, 0x55, 0x75, 0x53, 0x83, 0x84, 0x85, 0x86,
+    0x24, 0x25, 0x26, 0x27, 0xA1, 0xA0, 0x81, 0x80, 0x43, 0x42, 0x41, 0x40,
+    // D22-D37
+    0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+    0x37, 0x36, 0x35, 0x34, 0x33, 0x32, 0x31, 0x30,
+    // D38-D53
+    0x47, 0x72, 0x71, 0x70, 0xC7, 0xC6, 0xC5, 0xC4, 0xC3, 0xC2, 0xC1, 0xC0,
+    0x23, 0x22, 0x21, 0x20,
+    // D54-D69 (A0-A15)
+    0x60, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67,
+    0xB0, 0xB1, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7,
+#endif
+  };
+};
+
+/// \cond
 
-    uint16_t _lastPosition = 0;
+// The registers of each I/O port, numbered as by digitalPinToPort().
+template <uint8_t Port> struct QTRPortRegisters;
+
+#define QTR_PORT_REGISTERS(port, letter) \
+  template <> struct QTRPortRegisters<port> \
+  { \
+    static volatile uint8_t & input() { return PIN##letter; } \
+    static volatile uint8_t & mode() { return DDR##letter; } \
+    static volatile uint8_t & output() { return PORT##letter; } \
+  };
+#if defined(PORTA)
+QTR_PORT_REGISTERS(1, A)
+#endif
+#if defined(PORTB)
+QTR_PORT_REGISTERS(2, B)
+#endif
+#if defined(PORTC)
+QTR_PORT_REGISTERS(3, C)
+#endif
+#if defined(PORTD)
+QTR_PORT_REGISTERS(4, D)
+#endif
+#if defined(PORTE)
+QTR_PORT_REGISTERS(5, E)
+#endif
+#if defined(PORTF)
+QTR_PORT_REGISTERS(6, F)
+#endif
+#if defined(PORTG)
+QTR_PORT_REGISTERS(7, G)
+#endif
+#if defined(PORTH)
+QTR_PORT_REGISTERS(8, H)
+#endif
+#if defined(PORTJ)
+QTR_PORT_REGISTERS(10, J)
+#endif
+#if defined(PORTK)
+QTR_PORT_REGISTERS(11, K)
+#endif
+#if defined(PORTL)
+QTR_PORT_REGISTERS(12, L)
+#endif
+#undef QTR_PORT_REGISTERS
+
+// An RC sensor line on a pin known at compile time.
+template <uint8_t Pin>
+struct QTRPinLine
+{
+  typedef QTRPortRegisters<QTRPinTable::port(Pin)> Registers;
+  static const uint8_t Mask = QTRPinTable::mask(Pin);
+
+  // Drives the line high. (Setting the output first turns the pull-up on
+  // briefly instead of driving the line low.)
+  static void charge()
+  {
+    Registers::output() |= Mask;
+    Registers::mode() |= Mask;
+  }
+
+  // Makes the line an input with the pull-up disabled.
+  static void release()
+  {
+    Registers::mode() &= ~Mask;
+    Registers::output() &= ~Mask;
+  }
+
+  static bool low() { return (Registers::input() & Mask) == 0; }
+};
+
+#endif
+
+// Returns whether every pin in a list is valid for RC sensors: on boards with
+// a QTRPinTable, whether it is a digital pin.
+constexpr bool qtrRCPinsValid() { return true; }
+
+template <typename... Rest>
+constexpr bool qtrRCPinsValid(uint8_t pin, Rest... rest)
+{
+#if QTR_PIN_TABLES
+  return (QTRPinTable::port(pin) != 0) && qtrRCPinsValid(rest...);
+#else
+  return ((void)pin, qtrRCPinsValid(rest...));
+#endif
+}
+
+// Returns whether [pin] is not in a list.
+constexpr bool qtrPinAbsent(uint8_t) { return true; }
+
+template <typename... Rest>
+constexpr bool qtrPinAbsent(uint8_t pin, uint8_t other, Rest... rest)
+{
+  return (pin != other) && qtrPinAbsent(pin, rest...);
+}
+
+// Returns whether the pins in a list are all different.
+constexpr bool qtrPinsDistinct() { return true; }
+
+template <typename... Rest>
+constexpr bool qtrPinsDistinct(uint8_t pin, Rest... rest)
+{
+  return qtrPinAbsent(pin, rest...) && qtrPinsDistinct(rest...);
+}
+
+/// \endcond
+
+/// \brief Represents a QTR sensor array whose type and pins are fixed at
+/// compile time.
+///
+/// \tparam Type The sensor type: QTRType::RC or QTRType::Analog.
+///
+/// \tparam Pins The Arduino pins that the sensors are connected to.
+///
+/// This class works like a QTRSensors object that has been set up with
+/// setTypeRC() or setTypeAnalog() and setSensorPins(), except that the sensor
+/// type and pins are checked when your program is compiled, the number of
+/// sensors is available as a compile-time constant for sizing arrays, and
+/// all of the object's arrays are sized for exactly that many sensors and
+/// stored inside the object (see QTRSensorsFixed), so it never allocates
+/// memory on the heap.
+///
+/// On boards based on the ATmega168, ATmega328P, ATmega32U4, ATmega1280, and
+/// ATmega2560 (see QTRPinTable), the I/O port and bit of each RC sensor pin
+/// are also worked out at compile time, and read() charges, releases, and
+/// polls the sensor lines directly through the port registers, with no calls
+/// to `pinMode()` and no pin lookups at run time. This takes much less time
+/// than QTRSensors does, especially for charging and releasing the lines.
+/// Reads that go through startRead() and poll(), masked reads, and reads with
+/// settings other than the defaults for setRCTiming() still work as they do
+/// for QTRSensors. With analog sensors, reads work as they do for QTRSensors.
+///
+/// Example usage:
+/// ~~~{.cpp}
+/// // Four RC sensors connected to pins 6, 7, A0, and A1.
+/// QTRSensorsT<QTRType::RC, 6, 7, A0, A1> qtr;
+///
+/// uint16_t sensorValues[qtr.SensorCount];
+/// ~~~
+///
+/// Do not call setTypeRC(), setTypeAnalog(), setSensorPins(), or
+/// setBuffer() on an object of this class.
+template <QTRType Type, uint8_t... Pins>
+class QTRSensorsT : public QTRSensorsFixed<sizeof...(Pins)>
+{
+  static_assert(Type == QTRType::RC || Type == QTRType::Analog,
+    "The sensor type must be QTRType::RC or QTRType::Analog.");
+  static_assert(sizeof...(Pins) > 0, "At least one sensor pin is required.");
+  static_assert(sizeof...(Pins) <= QTRMaxSensors, "Too many sensor pins.");
+  static_assert(qtrPinsDistinct(Pins...), "Each sensor pin can only be used once.");
+  static_assert(Type != QTRType::RC || qtrRCPinsValid(Pins...),
+    "RC sensors must be connected to digital pins.");
+
+  public:
+
+    /// The number of sensors.
+    static constexpr uint8_t SensorCount = sizeof...(Pins);
+
+    QTRSensorsT()
+    {
+      if (Type == QTRType::RC) { this->setTypeRC(); } else { this->setTypeAnalog(); }
+
+      const uint8_t pins[] = { Pins... };
+      this->setSensorPins(pins, SensorCount);
+
+      useLines(IsRC());
+    }
+
+  private:
+
+    // Selects the overload of useLines() for the sensor type at compile time,
+    // so that the RC code is not compiled for analog sensors.
+    template <bool RC> struct TypeTag {};
+    typedef TypeTag<Type == QTRType::RC> IsRC;
+
+    void useLines(TypeTag<false>) {}
+
+#if !QTR_PIN_TABLES
+    void useLines(TypeTag<true>) {}
+#else
+    void useLines(TypeTag<true>) { this->_rcLines = accessLines; }
+
+    typedef QTRSensors::RCLineAction Action;
+
+    // Applies an action to the lines of the sensors from Index on, skipping
+    // the sensors with odd indexes if bit 1 of [skip] is set and those with
+    // even indexes if bit 0 is.
+    template <Action A, uint8_t Index, uint8_t... Rest> struct Lines;
+
+    template <Action A, uint8_t Index, uint8_t Pin>
+    struct Lines<A, Index, Pin>
+    {
+      static uint8_t apply(uint16_t * sensorValues, uint16_t time, uint8_t skip)
+      {
+        if (skip & (1 << (Index & 1))) { return 0; }
+
+        typedef QTRPinLine<Pin> Line;
+        switch (A)
+        {
+          case Action::Charge:
+            Line::charge();
+            return 0;
+
+          case Action::Release:
+            Line::release();
+            return 1;
+
+          default: // Action::Poll
+            if (Line::low() && (time < sensorValues[Index]))
+            {
+              // record the first time the line reads low
+              sensorValues[Index] = time;
+              return 1;
+            }
+            return 0;
+        }
+      }
+    };
+
+    template <Action A, uint8_t Index, uint8_t Pin, uint8_t Next, uint8_t... Rest>
+    struct Lines<A, Index, Pin, Next, Rest...>
+    {
+      static uint8_t apply(uint16_t * sensorValues, uint16_t time, uint8_t skip)
+      {
+        uint8_t count = Lines<A, Index, Pin>::apply(sensorValues, time, skip);
+        return count + Lines<A, Index + 1, Next, Rest...>::apply(sensorValues, time, skip);
+      }
+    };
+
+    // The readPrivate() passes read every sensor or every other one (a
+    // [step] of 2), starting with [start].
+    static uint8_t accessLines(Action action, uint16_t * sensorValues,
+                               uint16_t time, uint8_t start, uint8_t step)
+    {
+      uint8_t skip = (step == 1) ? 0 : ((start == 0) ? 2 : 1);
+
+      switch (action)
+      {
+        case Action::Charge:
+          return Lines<Action::Charge, 0, Pins...>::apply(sensorValues, time, skip);
+
+        case Action::Release:
+          return Lines<Action::Release, 0, Pins...>::apply(sensorValues, time, skip);
+
+        default: // Action::Poll
+          return Lines<Action::Poll, 0, Pins...>::apply(sensorValues, time, skip);
+      }
+    }
+#endif
 };
+
+template <QTRType Type, uint8_t... Pins>
+constexpr uint8_t QTRSensorsT<Type, Pins...>::SensorCount;
@@ -0,0 +1,146 @@
+#include <QTRSensors.h>
+
+// This example measures how long the library's reading functions take, so
+// that the performance of different configurations (and library versions) can
+// be compared. It is designed for use with up to eight RC sensors connected
+// to digital pins 3 to 10, or up to six analog sensors connected to analog
+// pins A0 to A5, with the emitter control pin (CTRL or LEDON) connected to
+// digital pin 2. It benchmarks both types, so it can be run with either type
+// connected; the timings for the other type will not be meaningful. You can
+// change the pin arrays below to list up to QTRMaxSensors pins. The
+// sensors do not need to be looking at anything in particular, but the
+// readings (and so the RC read times) depend on what they see, so keep them
+// in the same place when comparing results.
+//
+// For each sensor type, analog sample order, read mode, function, and number
+// of sensors (from 1 to the number of pins listed), the example times several
+// calls to the function and prints one line of comma-separated values to the
+// serial monitor:
+//
+//   type,order,mode,function,sensors,us_per_call,cycles_per_call
+//
+// The order is the numeric value of the QTRSampleOrder used for analog
+// sensors (0 = Interleaved, 1 = Burst, 2 = BurstDiscardFirst; always 0 for RC
+// sensors), so the cost of each order can be weighed against the crosstalk
+// it avoids on your board. The mode is the numeric value of the QTRReadMode
+// used (0 = Off, 1 = On, 2 = OnAndOff, 3 = OddEven, 4 = OddEvenAndOff,
+// 5 = Manual). Cycles are calculated from the measured time and the CPU clock
+// frequency.
+//
+// If the library is compiled with QTR_TIMING_STATS defined as 1 (this must
+// be done with a compiler flag that applies to the whole build, such as
+// -DQTR_TIMING_STATS=1, not a #define in this sketch), each line also
+// includes the mean time in microseconds of each phase listed in the
+// QTRPhase enum during those calls, and the header line names them.
+
+const uint8_t RCPins[] = {3, 4, 5, 6, 7, 8, 9, 10};
+const uint8_t AnalogPins[] = {A0, A1, A2, A3, A4, A5};
+const uint8_t EmitterPin = 2;
+
+// the number of calls timed for each line of output
+const uint8_t CallCount = 10;
+
+const char * const FunctionNames[] = {
+  "read", "readCalibrated", "readLineBlack", "readLineWhite", "calibrate"
+};
+const uint8_t FunctionCount = 5;
+
+QTRSensors qtr;
+uint16_t sensorValues[QTRMaxSensors];
+
+void callFunction(uint8_t function, QTRReadMode mode)
+{
+  switch (function)
+  {
+    case 0: qtr.read(sensorValues, mode); break;
+    case 1: qtr.readCalibrated(sensorValues, mode); break;
+    case 2: qtr.readLineBlack(sensorValues, mode); break;
+    case 3: qtr.readLineWhite(sensorValues, mode); break;
+    case 4: qtr.calibrate(mode); break;
+  }
+}
+
+void benchmark(QTRType type, uint8_t order, const uint8_t * pins,
+               uint8_t pinCount)
+{
+  for (uint8_t mode = 0; mode < 6; mode++)
+  {
+    for (uint8_t sensorCount = 1; sensorCount <= pinCount; sensorCount++)
+    {
+      qtr.setSensorPins(pins, sensorCount);
+
+      // Calibrate first so that the calibrated functions have something to
+      // work with. (This does nothing in QTRReadMode::Manual, so those
+      // functions return without reading the sensors in that mode.)
+      qtr.calibrate((QTRReadMode)mode);
+
+      for (uint8_t function = 0; function < FunctionCount; function++)
+      {
+#if QTR_TIMING_STATS
+        qtr.resetPhaseStats();
+#endif
+
+        uint32_t start = micros();
+        for (uint8_t i = 0; i < CallCount; i++)
+        {
+          callFunction(function, (QTRReadMode)mode);
+        }
+        uint32_t time = (micros() - start) / CallCount;
+
+        Serial.print((type == QTRType::RC) ? "RC" : "Analog");
+        Serial.print(',');
+        Serial.print(order);
+        Serial.print(',');
+        Serial.print(mode);
+        Serial.print(',');
+        Serial.print(FunctionNames[function]);
+        Serial.print(',');
+        Serial.print(sensorCount);
+        Serial.print(',');
+        Serial.print(time);
+        Serial.print(',');
+        Serial.print(time * clockCyclesPerMicrosecond());
+#if QTR_TIMING_STATS
+        for (uint8_t phase = 0; phase < QTRPhaseCount; phase++)
+        {
+          Serial.print(',');
+          Serial.print(qtr.getPhaseStats((QTRPhase)phase).mean());
+        }
+#endif
+        Serial.println();
+      }
+    }
+  }
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  delay(1000);
+
+  qtr.setEmitterPin(EmitterPin);
+
+  Serial.print(F("type,order,mode,function,sensors,us_per_call,"
+                 "cycles_per_call"));
+#if QTR_TIMING_STATS
+  Serial.print(F(",read_us,emitters_on_us,emitters_off_us,charge_us,"
+                 "discharge_us,analog_us,calibration_us,line_us"));
+#endif
+  Serial.println();
+
+  qtr.setTypeRC();
+  benchmark(QTRType::RC, 0, RCPins, sizeof(RCPins));
+
+  qtr.setTypeAnalog();
+  for (uint8_t order = 0; order < 3; order++)
+  {
+    qtr.setSampleOrder((QTRSampleOrder)order);
+    benchmark(QTRType::Analog, order, AnalogPins, sizeof(AnalogPins));
+  }
+
+  Serial.println(F("done"));
+}
+
+void loop()
+{
+}
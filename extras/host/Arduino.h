@@ -0,0 +1,149 @@
+// Host stand-in for the parts of the Arduino core that this library uses, so
+// that the library can be compiled and run on a PC against the simulated board
+// in HostArduino.cpp. It is not a complete Arduino core; see README.md.
+//
+// By default it stands in for a generic board, where RC sensors are polled
+// with digitalRead(). When compiled with __AVR__ and __AVR_ATmega328P__
+// defined (the Makefile's avr flavor), it also provides the ATmega328P port,
+// pin change interrupt, ADC, and status registers that the library uses on
+// AVR.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIGH 1
+#define LOW 0
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+unsigned long micros();
+unsigned long millis();
+void delayMicroseconds(unsigned int us);
+void delay(unsigned long ms);
+
+void noInterrupts();
+void interrupts();
+
+#define NOT_AN_INTERRUPT -1
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t interrupt);
+
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+
+#if defined(__AVR__)
+
+// Pins 0 to 7 are on port D, 8 to 13 on port B, and 14 to 19 (A0 to A5) on
+// port C, as on an Arduino Uno.
+#define NOT_A_PORT 0
+#define PB 2
+#define PC 3
+#define PD 4
+
+extern volatile uint8_t hostPortInput[5];
+extern volatile uint8_t hostPortOutput[5];
+extern volatile uint8_t hostPortMode[5];
+
+#define digitalPinToPort(p) \
+  ((p) < 8 ? PD : ((p) < 14 ? PB : ((p) < 20 ? PC : NOT_A_PORT)))
+#define digitalPinToBitMask(p) \
+  ((uint8_t)((p) < 8 ? 1 << (p) : ((p) < 14 ? 1 << ((p) - 8) : \
+    ((p) < 20 ? 1 << ((p) - 14) : 0))))
+#define portInputRegister(port) \
+  ((port) == NOT_A_PORT ? (volatile uint8_t *)0 : &hostPortInput[port])
+#define portOutputRegister(port) \
+  ((port) == NOT_A_PORT ? (volatile uint8_t *)0 : &hostPortOutput[port])
+#define portModeRegister(port) \
+  ((port) == NOT_A_PORT ? (volatile uint8_t *)0 : &hostPortMode[port])
+
+#define PINB hostPortInput[PB]
+#define PINC hostPortInput[PC]
+#define PIND hostPortInput[PD]
+#define DDRB hostPortMode[PB]
+#define DDRC hostPortMode[PC]
+#define DDRD hostPortMode[PD]
+#define PORTB hostPortOutput[PB]
+#define PORTC hostPortOutput[PC]
+#define PORTD hostPortOutput[PD]
+
+// The status register; only its global interrupt enable bit is simulated.
+struct HostStatusRegister
+{
+  operator uint8_t() const;
+  HostStatusRegister & operator=(uint8_t value);
+};
+extern HostStatusRegister SREG;
+void cli();
+void sei();
+
+// Interrupt handlers are plain functions named after their vectors, which
+// the simulated board calls when their interrupts are pending and enabled.
+#define ISR(vector, ...) \
+  extern "C" void vector(void) __VA_ARGS__; extern "C" void vector(void)
+#define ISR_ALIASOF(vector) __attribute__((alias(#vector)))
+
+// The pin change interrupt registers. Writing a 1 to a bit of PCIFR clears
+// that flag, as on the real hardware.
+extern volatile uint8_t PCICR;
+extern volatile uint8_t PCMSK0;
+extern volatile uint8_t PCMSK1;
+extern volatile uint8_t PCMSK2;
+struct HostFlagRegister
+{
+  uint8_t flags;
+  operator uint8_t() const { return flags; }
+  HostFlagRegister & operator=(uint8_t value) { flags &= ~value; return *this; }
+};
+extern HostFlagRegister PCIFR;
+
+#define digitalPinToPCICR(p) ((p) < 20 ? &PCICR : (volatile uint8_t *)0)
+#define digitalPinToPCICRbit(p) ((p) < 8 ? 2 : ((p) < 14 ? 0 : 1))
+#define digitalPinToPCMSK(p) \
+  ((p) < 8 ? &PCMSK2 : ((p) < 14 ? &PCMSK0 : \
+    ((p) < 20 ? &PCMSK1 : (volatile uint8_t *)0)))
+#define digitalPinToPCMSKbit(p) \
+  ((p) < 8 ? (p) : ((p) < 14 ? (p) - 8 : (p) - 14))
+
+// The ADC registers exist so that the library compiles, but the ADC itself is
+// not simulated: conversions only happen through analogRead(), so do not use
+// QTR_ADC_ISR or QTRAnalogTiming::Interrupt on the host.
+extern volatile uint8_t ADCSRA;
+extern volatile uint8_t ADCSRB;
+extern volatile uint8_t ADMUX;
+extern volatile uint16_t ADC;
+#define ADIE 3
+#define ADIF 4
+#define ADSC 6
+
+// As on an Arduino Uno, only pins 2 and 3 have external interrupts.
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : NOT_AN_INTERRUPT))
+
+#else
+
+// Every pin has an external interrupt, numbered like the pin.
+#define digitalPinToInterrupt(p) ((int)(p))
+
+#endif
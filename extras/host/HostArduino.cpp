@@ -0,0 +1,418 @@
+// A simulated board for running the library on a PC; see HostArduino.h and
+// README.md.
+
+#include "HostArduino.h"
+
+HostCosts hostCosts;
+HostCallCounts hostCalls;
+
+static double now = 0; // virtual time in microseconds
+
+static HostPinModel defaultModel;
+static HostPinModel * model = &defaultModel;
+
+static bool interruptsEnabled = true;
+static bool inInterrupt = false;
+
+static void (*timerHandler)(void) = nullptr; // set with hostSetTimer()
+static double timerPeriod;
+static double timerNext; // when the timer interrupt is next due
+
+struct PinState
+{
+  bool used;
+  bool driven; // whether the model was last told the pin is driven high
+  bool level;
+#if !defined(__AVR__)
+  uint8_t mode;
+  bool output;
+#endif
+  void (*handler)(void); // attached with attachInterrupt()
+  int handlerMode;
+  bool pending;
+};
+
+static PinState pins[HostPinCount];
+
+// Only the pins the sketch has used are updated as time passes.
+static uint8_t usedPins[HostPinCount];
+static uint8_t usedPinCount = 0;
+
+#if defined(__AVR__)
+volatile uint8_t hostPortInput[5];
+volatile uint8_t hostPortOutput[5];
+volatile uint8_t hostPortMode[5];
+
+HostStatusRegister SREG;
+
+volatile uint8_t PCICR;
+volatile uint8_t PCMSK0;
+volatile uint8_t PCMSK1;
+volatile uint8_t PCMSK2;
+HostFlagRegister PCIFR;
+
+volatile uint8_t ADCSRA = 0x87;
+volatile uint8_t ADCSRB;
+volatile uint8_t ADMUX = 0x40;
+volatile uint16_t ADC;
+
+// defined by the sketch with ISR(), if at all
+extern "C" void PCINT0_vect(void) __attribute__((weak));
+extern "C" void PCINT1_vect(void) __attribute__((weak));
+extern "C" void PCINT2_vect(void) __attribute__((weak));
+#endif
+
+static void usePin(uint8_t pin)
+{
+  if (pins[pin].used) { return; }
+  pins[pin].used = true;
+  usedPins[usedPinCount++] = pin;
+}
+
+static bool outputLatch(uint8_t pin)
+{
+#if defined(__AVR__)
+  return hostPortOutput[digitalPinToPort(pin)] & digitalPinToBitMask(pin);
+#else
+  return pins[pin].output;
+#endif
+}
+
+static void setOutputLatch(uint8_t pin, bool high)
+{
+#if defined(__AVR__)
+  if (high) { hostPortOutput[digitalPinToPort(pin)] |= digitalPinToBitMask(pin); }
+  else { hostPortOutput[digitalPinToPort(pin)] &= ~digitalPinToBitMask(pin); }
+#else
+  pins[pin].output = high;
+#endif
+}
+
+uint8_t hostPinMode(uint8_t pin)
+{
+  if (pin >= HostPinCount) { return INPUT; }
+#if defined(__AVR__)
+  uint8_t port = digitalPinToPort(pin);
+  uint8_t mask = digitalPinToBitMask(pin);
+  if (hostPortMode[port] & mask) { return OUTPUT; }
+  return (hostPortOutput[port] & mask) ? INPUT_PULLUP : INPUT;
+#else
+  return pins[pin].mode;
+#endif
+}
+
+bool hostDrivenHigh(uint8_t pin)
+{
+  return (hostPinMode(pin) == OUTPUT) && outputLatch(pin);
+}
+
+// Latches an interrupt for a pin that has just changed to [level].
+static void pinChanged(uint8_t pin, bool level)
+{
+#if defined(__AVR__)
+  if (*digitalPinToPCMSK(pin) & (1 << digitalPinToPCMSKbit(pin)))
+  {
+    PCIFR.flags |= 1 << digitalPinToPCICRbit(pin);
+  }
+#endif
+  if (pins[pin].handler == nullptr) { return; }
+  int mode = pins[pin].handlerMode;
+  if ((mode == CHANGE) || ((mode == FALLING) && !level) || ((mode == RISING) && level))
+  {
+    pins[pin].pending = true;
+  }
+}
+
+// Runs the handlers of pending interrupts, with interrupts disabled, until
+// none are left.
+static void serviceInterrupts()
+{
+  if (!interruptsEnabled || inInterrupt) { return; }
+
+  inInterrupt = true;
+  interruptsEnabled = false;
+
+  bool ran;
+  do
+  {
+    ran = false;
+#if defined(__AVR__)
+    void (* const vectors[])(void) = { PCINT0_vect, PCINT1_vect, PCINT2_vect };
+    for (uint8_t group = 0; group < 3; group++)
+    {
+      uint8_t bit = 1 << group;
+      if ((PCIFR.flags & PCICR & bit) && (vectors[group] != nullptr))
+      {
+        PCIFR.flags &= ~bit;
+        hostCalls.interrupts++;
+        vectors[group]();
+        ran = true;
+      }
+    }
+#endif
+    for (uint8_t i = 0; i < usedPinCount; i++)
+    {
+      PinState & state = pins[usedPins[i]];
+      if (state.pending && (state.handler != nullptr))
+      {
+        state.pending = false;
+        hostCalls.interrupts++;
+        state.handler();
+        ran = true;
+      }
+    }
+  } while (ran);
+
+  // The timer runs at most once per call, so that the sketch still makes
+  // progress if the handler takes longer than the period.
+  if ((timerHandler != nullptr) && (now >= timerNext))
+  {
+    // Like a hardware timer, ticks that pass while the interrupt is pending
+    // are lost.
+    while (timerNext <= now) { timerNext += timerPeriod; }
+    hostCalls.interrupts++;
+    timerHandler();
+  }
+
+  interruptsEnabled = true;
+  inInterrupt = false;
+}
+
+// Brings the pins up to date with the current time, and runs any interrupt
+// handlers that are due.
+static void update()
+{
+#if defined(__AVR__)
+  // Pins can also be put to use by writing to the port registers directly.
+  for (uint8_t pin = 0; pin < HostPinCount; pin++)
+  {
+    if (!pins[pin].used &&
+        (hostPortMode[digitalPinToPort(pin)] & digitalPinToBitMask(pin)))
+    {
+      usePin(pin);
+    }
+  }
+#endif
+
+  for (uint8_t i = 0; i < usedPinCount; i++)
+  {
+    uint8_t pin = usedPins[i];
+    PinState & state = pins[pin];
+
+    bool driven = hostDrivenHigh(pin);
+    if (driven != state.driven)
+    {
+      state.driven = driven;
+      model->drivenChanged(pin, driven);
+    }
+
+    bool level = (hostPinMode(pin) == OUTPUT) ? outputLatch(pin) : model->inputLevel(pin);
+    if (level != state.level)
+    {
+      state.level = level;
+      pinChanged(pin, level);
+    }
+
+#if defined(__AVR__)
+    if (level) { hostPortInput[digitalPinToPort(pin)] |= digitalPinToBitMask(pin); }
+    else { hostPortInput[digitalPinToPort(pin)] &= ~digitalPinToBitMask(pin); }
+#endif
+  }
+
+  serviceInterrupts();
+}
+
+void hostSetPinModel(HostPinModel * newModel)
+{
+  model = (newModel != nullptr) ? newModel : &defaultModel;
+}
+
+double hostTime()
+{
+  return now;
+}
+
+// Returns whether any pin interrupts are enabled.
+static bool pinInterruptsEnabled()
+{
+#if defined(__AVR__)
+  if (PCICR != 0) { return true; }
+#endif
+  for (uint8_t i = 0; i < usedPinCount; i++)
+  {
+    if (pins[usedPins[i]].handler != nullptr) { return true; }
+  }
+  return false;
+}
+
+void hostAdvance(double us)
+{
+  double end = now + us;
+
+  // Stop at each tick of the timer, and every microsecond while pin
+  // interrupts are enabled, so that interrupts run on time.
+  do
+  {
+    double next = end;
+    if ((timerHandler != nullptr) && (timerNext > now) && (timerNext < next))
+    {
+      next = timerNext;
+    }
+    if (pinInterruptsEnabled() && (now + 1 < next)) { next = now + 1; }
+
+    if (next > now) { now = next; }
+    update();
+  } while ((now < end) && interruptsEnabled);
+}
+
+void hostSetTimer(void (*handler)(void), double period)
+{
+  timerHandler = handler;
+  timerPeriod = period;
+  timerNext = now + period;
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  hostCalls.pinMode++;
+  now += hostCosts.pinMode;
+  if (pin < HostPinCount)
+  {
+    usePin(pin);
+#if defined(__AVR__)
+    // Like the AVR core, this also turns the pull-up on or off for inputs.
+    uint8_t port = digitalPinToPort(pin);
+    uint8_t mask = digitalPinToBitMask(pin);
+    if (mode == OUTPUT) { hostPortMode[port] |= mask; }
+    else
+    {
+      hostPortMode[port] &= ~mask;
+      setOutputLatch(pin, mode == INPUT_PULLUP);
+    }
+#else
+    pins[pin].mode = mode;
+#endif
+  }
+  update();
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  hostCalls.digitalWrite++;
+  now += hostCosts.digitalWrite;
+  if (pin < HostPinCount)
+  {
+    usePin(pin);
+    setOutputLatch(pin, value != LOW);
+  }
+  update();
+}
+
+int digitalRead(uint8_t pin)
+{
+  hostCalls.digitalRead++;
+  now += hostCosts.digitalRead;
+  if (pin >= HostPinCount) { update(); return LOW; }
+  usePin(pin);
+  update();
+  return pins[pin].level ? HIGH : LOW;
+}
+
+int analogRead(uint8_t pin)
+{
+  hostCalls.analogRead++;
+  now += hostCosts.analogRead;
+  if (pin >= HostPinCount) { update(); return 0; }
+  usePin(pin);
+  update();
+  return model->analogInput(pin);
+}
+
+unsigned long micros()
+{
+  hostCalls.micros++;
+  now += hostCosts.micros;
+  update();
+  return (unsigned long)now;
+}
+
+unsigned long millis()
+{
+  return (unsigned long)(now / 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  hostAdvance(us);
+}
+
+void delay(unsigned long ms)
+{
+  hostAdvance(ms * 1000.0);
+}
+
+void noInterrupts()
+{
+  interruptsEnabled = false;
+}
+
+void interrupts()
+{
+  interruptsEnabled = true;
+  serviceInterrupts();
+}
+
+#if defined(__AVR__)
+
+HostStatusRegister::operator uint8_t() const
+{
+  return interruptsEnabled ? 0x80 : 0;
+}
+
+HostStatusRegister & HostStatusRegister::operator=(uint8_t value)
+{
+  if (value & 0x80) { interrupts(); }
+  else { noInterrupts(); }
+  return *this;
+}
+
+void cli()
+{
+  noInterrupts();
+}
+
+void sei()
+{
+  interrupts();
+}
+
+#endif
+
+// Returns the pin of an external interrupt (see digitalPinToInterrupt() in
+// Arduino.h), or HostPinCount if there is no such interrupt.
+static uint8_t interruptPin(uint8_t interrupt)
+{
+#if defined(__AVR__)
+  return (interrupt < 2) ? interrupt + 2 : HostPinCount;
+#else
+  return (interrupt < HostPinCount) ? interrupt : HostPinCount;
+#endif
+}
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode)
+{
+  uint8_t pin = interruptPin(interrupt);
+  if (pin >= HostPinCount) { return; }
+  usePin(pin);
+  pins[pin].handler = handler;
+  pins[pin].handlerMode = mode;
+  pins[pin].pending = false;
+}
+
+void detachInterrupt(uint8_t interrupt)
+{
+  uint8_t pin = interruptPin(interrupt);
+  if (pin >= HostPinCount) { return; }
+  pins[pin].handler = nullptr;
+  pins[pin].pending = false;
+}
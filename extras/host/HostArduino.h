@@ -0,0 +1,111 @@
+// Control of the simulated board provided by HostArduino.cpp.
+//
+// Time on the simulated board is virtual: it only passes when the library (or
+// the benchmark) calls into the Arduino core, and each call takes the time
+// given in hostCosts. Runs are therefore deterministic, and the same run gives
+// the same times on any PC.
+
+#pragma once
+
+#include <Arduino.h>
+
+/// The number of pins the simulated board has.
+#if defined(__AVR__)
+const uint8_t HostPinCount = 20;
+#else
+const uint8_t HostPinCount = 64;
+#endif
+
+/// \brief How many microseconds of virtual time each Arduino core function
+/// takes.
+///
+/// The defaults are rough figures for a 16 MHz AVR.
+struct HostCosts
+{
+  double micros = 1;
+  double digitalRead = 3;
+  double digitalWrite = 3;
+  double pinMode = 3;
+  double analogRead = 112;
+};
+
+/// The costs used by the simulated board, which can be changed at any time.
+extern HostCosts hostCosts;
+
+/// \brief How many times each Arduino core function has been called, and
+/// how many interrupt handlers have run.
+struct HostCallCounts
+{
+  unsigned long micros;
+  unsigned long digitalRead;
+  unsigned long digitalWrite;
+  unsigned long pinMode;
+  unsigned long analogRead;
+  unsigned long interrupts;
+};
+
+/// The call counts, which can be reset at any time.
+extern HostCallCounts hostCalls;
+
+/// \brief Decides what the simulated board's input pins read.
+///
+/// The default model reads every input as low and every analog input as 0.
+/// HostSensors.h provides a model of QTR sensors.
+class HostPinModel
+{
+  public:
+    virtual ~HostPinModel() {}
+
+    /// \brief Called when a pin starts or stops being driven high.
+    ///
+    /// \param pin The pin.
+    /// \param high Whether the pin is now an output driven high.
+    ///
+    /// This is called at the virtual time the change takes effect. Direct
+    /// writes to the port registers take effect at the next call into the
+    /// Arduino core.
+    virtual void drivenChanged(uint8_t pin, bool high) { (void)pin; (void)high; }
+
+    /// \brief Returns the level of a pin that is not an output.
+    virtual bool inputLevel(uint8_t pin) { (void)pin; return false; }
+
+    /// \brief Returns the result of an analogRead() of a pin.
+    virtual int analogInput(uint8_t pin) { (void)pin; return 0; }
+};
+
+/// \brief Selects the model that decides what the input pins read.
+///
+/// \param model The model, or nullptr for the default model. It must stay
+/// valid until another model is selected.
+void hostSetPinModel(HostPinModel * model);
+
+/// \brief Returns the current virtual time in microseconds.
+double hostTime();
+
+/// \brief Lets [us] microseconds of virtual time pass, as if the sketch were
+/// doing other work.
+///
+/// Pin changes are noticed and pending interrupts run as they would during
+/// any other call into the Arduino core. While any pin interrupts are
+/// enabled, the time passes one microsecond at a time, so that their handlers
+/// run within a microsecond of the change, as they would while the sketch
+/// was busy with work that does not disable interrupts.
+void hostAdvance(double us);
+
+/// \brief Starts or stops a periodic timer interrupt.
+///
+/// \param handler The function to call every [period] microseconds, with
+/// interrupts disabled, or nullptr to stop the timer.
+/// \param period The time between calls, starting now.
+///
+/// Like the other interrupts, the handler only runs when the sketch calls
+/// into the Arduino core with interrupts enabled, so it can run late (and
+/// ticks can be lost) while the sketch is busy in a long call such as
+/// analogRead(). hostAdvance() stops at each tick.
+void hostSetTimer(void (*handler)(void), double period);
+
+/// \brief Returns the mode a pin was last set to with pinMode().
+uint8_t hostPinMode(uint8_t pin);
+
+/// \brief Returns whether a pin is an output driven high.
+bool hostDrivenHigh(uint8_t pin);
@@ -0,0 +1,92 @@
+// A model of QTR sensors connected to the simulated board; see HostSensors.h.
+
+#include "HostSensors.h"
+
+double HostSensors::emitterBrightness(uint8_t pin) const
+{
+  if (pin >= HostPinCount) { return 0; }
+
+  const PinState & state = _pins[pin];
+  double elapsed = hostTime() - state.changeTime;
+  if (state.driven)
+  {
+    if (elapsed >= emitterRiseTime) { return 1; }
+    double brightness = state.changeBrightness + elapsed / emitterRiseTime;
+    return (brightness < 1) ? brightness : 1;
+  }
+  else
+  {
+    if (elapsed >= emitterFallTime) { return 0; }
+    double brightness = state.changeBrightness - elapsed / emitterFallTime;
+    return (brightness > 0) ? brightness : 0;
+  }
+}
+
+double HostSensors::light(uint8_t pin) const
+{
+  const HostSensor & sensor = _sensors[pin];
+  double light = emitterBrightness(sensor.emitterPin) +
+    emitterBrightness(sensor.crosstalkEmitterPin) * sensor.crosstalk;
+  return (light < 1) ? light : 1;
+}
+
+void HostSensors::drivenChanged(uint8_t pin, bool high)
+{
+  PinState & state = _pins[pin];
+
+  // Emitters start changing brightness from wherever they are now.
+  state.changeBrightness = emitterBrightness(pin);
+  state.changeTime = hostTime();
+  state.driven = high;
+
+  if (high)
+  {
+    state.charged = true;
+  }
+  else if (state.charged && (hostPinMode(pin) != OUTPUT))
+  {
+    // An RC output has been released: it discharges at a rate set by how
+    // much light reaches the sensor.
+    const HostSensor & sensor = _sensors[pin];
+    double time = sensor.rcDischarge * (1 - (1 - sensor.rcLitFactor) * light(pin)) -
+      sensor.ambient;
+    state.dischargeTime = hostTime() + ((time > 0) ? time : 0);
+    state.charged = false;
+  }
+  else
+  {
+    // driven low, which discharges it at once
+    state.dischargeTime = hostTime();
+    state.charged = false;
+  }
+}
+
+bool HostSensors::inputLevel(uint8_t pin)
+{
+  return hostTime() < _pins[pin].dischargeTime;
+}
+
+int HostSensors::analogInput(uint8_t pin)
+{
+  const HostSensor & sensor = _sensors[pin];
+  double level = sensor.analogLevel - sensor.analogLitDrop * light(pin) + sensor.ambient;
+
+  if (analogNoise > 0)
+  {
+    _noiseState = _noiseState * 1664525 + 1013904223;
+    level += analogNoise * ((_noiseState >> 8) / (double)(1UL << 23) - 1);
+  }
+
+  if (level < 0) { level = 0; }
+  if (level > 1023) { level = 1023; }
+  int value = (int)(level + 0.5);
+
+  if ((adcCrosstalk > 0) && (_lastAnalogPin >= 0) && (_lastAnalogPin != pin))
+  {
+    value = (int)(value * (1 - adcCrosstalk) + _lastAnalogValue * adcCrosstalk + 0.5);
+  }
+  _lastAnalogPin = pin;
+  _lastAnalogValue = value;
+
+  return value;
+}
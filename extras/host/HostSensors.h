@@ -0,0 +1,98 @@
+// A model of QTR sensors connected to the simulated board; see README.md.
+
+#pragma once
+
+#include "HostArduino.h"
+#include <QTRSensors.h>
+
+/// \brief What a simulated sensor sees, and which emitters light it.
+struct HostSensor
+{
+  /// How long, in microseconds, an RC sensor's output takes to discharge
+  /// after it is released, in the dark with its emitters off.
+  double rcDischarge = 1000;
+
+  /// The fraction of rcDischarge left when the sensor's emitters are fully
+  /// on. The darker the surface, the closer this is to 1.
+  double rcLitFactor = 0.5;
+
+  /// The analogRead() result in the dark with the sensor's emitters off.
+  double analogLevel = 1000;
+
+  /// How much the analogRead() result drops when the sensor's emitters are
+  /// fully on. The darker the surface, the closer this is to 0.
+  double analogLitDrop = 300;
+
+  /// Ambient light: this shortens the RC discharge time by this many
+  /// microseconds, and raises the analogRead() result by this much.
+  double ambient = 0;
+
+  /// The emitter control pin whose emitters light this sensor, or
+  /// QTRNoEmitterPin if none.
+  uint8_t emitterPin = QTRNoEmitterPin;
+
+  /// Another emitter control pin, whose emitters light this sensor with the
+  /// brightness multiplied by crosstalk, or QTRNoEmitterPin if none. This
+  /// models emitters on one side of an odd/even pair reaching the sensors on
+  /// the other side.
+  uint8_t crosstalkEmitterPin = QTRNoEmitterPin;
+  double crosstalk = 0;
+};
+
+/// \brief A pin model for the simulated board in which each pin can have a
+/// QTR sensor connected to it.
+///
+/// An RC sensor's output reads high while it is driven high, and for a time
+/// after it is released that depends on how brightly its emitters are lit at
+/// the time of the release. An analog sensor's reading depends on how
+/// brightly they are lit when it is read.
+///
+/// Select it with hostSetPinModel().
+class HostSensors : public HostPinModel
+{
+  public:
+    /// \brief Returns the sensor connected to a pin.
+    HostSensor & operator[](uint8_t pin) { return _sensors[pin]; }
+
+    /// How long, in microseconds, emitters take to go from off to fully on
+    /// and from fully on to off. The brightness changes linearly.
+    double emitterRiseTime = 0;
+    double emitterFallTime = 0;
+
+    /// The peak amplitude of uniformly distributed noise added to every
+    /// analogRead() result. The noise is pseudo-random but repeatable.
+    double analogNoise = 0;
+
+    /// The fraction of the previous analogRead() result that leaks into the
+    /// next one when it is for a different pin, like the charge left on the
+    /// ADC's sample-and-hold capacitor with high-impedance sensors.
+    double adcCrosstalk = 0;
+
+    /// \brief Returns how brightly the emitters controlled by a pin are lit,
+    /// from 0 (off) to 1 (fully on).
+    double emitterBrightness(uint8_t pin) const;
+
+    /// \brief Returns how brightly the sensor connected to a pin is lit by
+    /// its emitters, from 0 to 1.
+    double light(uint8_t pin) const;
+
+    void drivenChanged(uint8_t pin, bool high) override;
+    bool inputLevel(uint8_t pin) override;
+    int analogInput(uint8_t pin) override;
+
+  private:
+    struct PinState
+    {
+      bool driven;
+      double changeTime; // when driven last changed
+      double changeBrightness; // the emitter brightness at changeTime
+      bool charged; // whether an RC output has been charged since it was last read low
+      double dischargeTime; // when a released RC output reads low
+    };
+
+    HostSensor _sensors[HostPinCount];
+    PinState _pins[HostPinCount] = {};
+    uint32_t _noiseState = 1;
+    int _lastAnalogPin = -1;
+    int _lastAnalogValue = 0;
+};
@@ -0,0 +1,149 @@
+// Reports the frame rate of background acquisition with QTRAcquisition, the
+// frames it drops when the main loop retrieves them too rarely, and how its
+// values compare with those of blocking read() calls, in each read mode.
+//
+// 8 RC sensors on pins 4 to 11 and 6 analog sensors on A0 to A5, with
+// emitters on pin 2 that take 50 us to turn on and off. tick() is called by
+// a simulated timer interrupt every 100 us for RC sensors and every 1 ms for
+// analog sensors, which take one sample per sensor (about 700 us in all) on
+// each tick. The main loop retrieves the frames every 1 ms or every 20 ms for
+// 200 ms, with a buffer of 4 frames. The blocking rate is the number of
+// back-to-back read() calls per second, which take the whole processor.
+//
+// The last column is the largest difference between the values in any frame
+// (retrieved every 1 ms) and those of a blocking read. RC lines are only
+// checked once per tick, so RC values differ by up to the timer period.
+
+#include "HostSensors.h"
+#include <QTRAcquisition.h>
+#include <stdio.h>
+
+const uint8_t RCPins[] = {4, 5, 6, 7, 8, 9, 10, 11};
+const uint8_t AnalogPins[] = {A0, A1, A2, A3, A4, A5};
+const uint8_t MaxSensors = 8;
+const double RCTickPeriod = 100;
+const double AnalogTickPeriod = 1000;
+const double RunTime = 200000;
+const uint8_t BlockingReads = 20;
+
+const char * const ModeNames[] = {"Off", "On", "OnAndOff", "OddEven", "OddEvenAndOff"};
+
+typedef QTRAcquisition<MaxSensors> Acquisition;
+
+static Acquisition * acquisition;
+
+static void onTimer()
+{
+  acquisition->tick();
+}
+
+struct Result
+{
+  unsigned long frames;
+  uint16_t dropped;
+  int maxDifference;
+};
+
+// Runs acquisition for [RunTime], retrieving the frames every
+// [drainInterval], and compares them with [expected].
+static Result acquire(QTRSensors & qtr, QTRReadMode mode, double tickPeriod,
+                      double drainInterval, const uint16_t * expected)
+{
+  Acquisition background(qtr);
+  acquisition = &background;
+
+  Result result = {};
+  background.begin(mode);
+  hostSetTimer(onTimer, tickPeriod);
+
+  double end = hostTime() + RunTime;
+  while (hostTime() < end)
+  {
+    hostAdvance(drainInterval);
+
+    Acquisition::Frame frame;
+    while (background.read(frame))
+    {
+      result.frames++;
+      for (uint8_t i = 0; i < qtr.getSensorCount(); i++)
+      {
+        int difference = abs((int)frame.values[i] - (int)expected[i]);
+        if (difference > result.maxDifference) { result.maxDifference = difference; }
+      }
+    }
+  }
+
+  hostSetTimer(nullptr, 0);
+  background.end();
+  result.dropped = background.getDroppedFrames();
+  return result;
+}
+
+int main()
+{
+  HostSensors sensors;
+  hostSetPinModel(&sensors);
+  sensors.emitterRiseTime = 50;
+  sensors.emitterFallTime = 50;
+  for (uint8_t i = 0; i < MaxSensors; i++)
+  {
+    HostSensor & sensor = sensors[RCPins[i]];
+    sensor.rcDischarge = 400 + 150 * i;
+    sensor.ambient = 10 * i;
+    sensor.emitterPin = 2;
+  }
+  for (uint8_t i = 0; i < sizeof(AnalogPins); i++)
+  {
+    HostSensor & sensor = sensors[AnalogPins[i]];
+    sensor.analogLevel = 400 + 100 * i;
+    sensor.ambient = 10 * i;
+    sensor.emitterPin = 2;
+  }
+
+  printf("type    mode           blocking frames/s  frames/s  dropped (1 ms)"
+    "  dropped (20 ms)  max difference\n");
+
+  for (uint8_t analog = 0; analog < 2; analog++)
+  {
+    for (uint8_t mode = 0; mode < 5; mode++)
+    {
+      QTRSensors qtr;
+      if (analog)
+      {
+        qtr.setTypeAnalog();
+        qtr.setSensorPins(AnalogPins, sizeof(AnalogPins));
+      }
+      else
+      {
+        qtr.setTypeRC();
+        qtr.setSensorPins(RCPins, sizeof(RCPins));
+      }
+      qtr.setEmitterPin(2);
+
+      uint16_t expected[MaxSensors];
+      double start = hostTime();
+      for (uint8_t n = 0; n < BlockingReads; n++)
+      {
+        qtr.read(expected, (QTRReadMode)mode);
+      }
+      double blockingTime = (hostTime() - start) / BlockingReads;
+
+      double tickPeriod = analog ? AnalogTickPeriod : RCTickPeriod;
+      Result often = acquire(qtr, (QTRReadMode)mode, tickPeriod, 1000, expected);
+      Result rarely = acquire(qtr, (QTRReadMode)mode, tickPeriod, 20000, expected);
+
+      printf("%-6s  %-13s  %17.0f  %8.0f  %14u  %15u  %14d\n",
+        analog ? "analog" : "RC", ModeNames[mode], 1e6 / blockingTime,
+        often.frames * 1e6 / RunTime, often.dropped, rarely.dropped,
+        often.maxDifference);
+    }
+  }
+
+  // begin() refuses an array with more sensors than a frame holds.
+  QTRSensors qtr;
+  qtr.setTypeRC();
+  qtr.setSensorPins(RCPins, sizeof(RCPins));
+  QTRAcquisition<4> small(qtr);
+  printf("begin() with %u sensors and frames of 4: %s\n", qtr.getSensorCount(),
+    small.begin() ? "started" : "refused");
+}
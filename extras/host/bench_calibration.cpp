@@ -0,0 +1,141 @@
+// Checks that readCalibrated(), which multiplies each reading by a cached
+// multiplier instead of dividing by the calibration range, gives the same
+// values as the division it replaced or values 1 higher.
+//
+// One analog sensor on A0 with 16-bit analog resolution, whose readings are
+// set directly, read in QTRReadMode::Off with calibration values set
+// directly. The multiplier is compared with a QTRSensorsFixed without
+// QTRBufferCalibrationCache, which still divides, and the division is
+// compared with reading * 1000 / range computed here. Every reading is
+// checked for every 10-bit range. For every 16-bit range, the ends of the
+// range and the readings at and just below the steps of the result to 1,
+// 100, 200, ... 900 are checked. Finally, readings far above a small range,
+// which used to overflow and come out as 0, are checked.
+//
+// This does not compare speed: a PC divides much faster than an AVR, so host
+// timings say little about the cycles saved. To compare cycle counts on a
+// real board, run the QTRBenchmark example with QTR_TIMING_STATS enabled,
+// which reports the time of the Calibration phase.
+
+#include "HostArduino.h"
+#include <QTRSensors.h>
+#include <stdio.h>
+
+const uint8_t SensorPin = A0;
+
+// A pin model whose analog readings are set directly.
+class Readings : public HostPinModel
+{
+  public:
+    int analogInput(uint8_t pin) override { (void)pin; return reading; }
+    uint16_t reading = 0;
+};
+
+static Readings readings;
+
+struct Counts
+{
+  unsigned long checked;
+  unsigned long same;
+  unsigned long higher;
+  unsigned long other;
+  unsigned long divisionWrong;
+};
+
+static void setUp(QTRSensors & qtr)
+{
+  qtr.setTypeAnalog();
+  qtr.setAnalogResolution(16);
+  qtr.setSensorPins(&SensorPin, 1);
+  qtr.calibrate(QTRReadMode::Off); // allocates the calibration arrays
+}
+
+static void setRange(QTRSensors & qtr, uint16_t minimum, uint16_t maximum)
+{
+  qtr.calibrationOff.minimum[0] = minimum;
+  qtr.calibrationOff.maximum[0] = maximum;
+}
+
+static uint16_t readCalibrated(QTRSensors & qtr, uint16_t reading)
+{
+  uint16_t value;
+  readings.reading = reading;
+  qtr.readCalibrated(&value, QTRReadMode::Off);
+  return value;
+}
+
+static void check(QTRSensors & scaled, QTRSensors & divided, uint16_t range,
+                  uint16_t reading, Counts & counts)
+{
+  uint16_t scaledValue = readCalibrated(scaled, reading);
+  uint16_t dividedValue = readCalibrated(divided, reading);
+  uint32_t expected = (reading >= range) ? 1000 : (uint32_t)reading * 1000 / range;
+
+  counts.checked++;
+  if (scaledValue == dividedValue) { counts.same++; }
+  else if (scaledValue == dividedValue + 1) { counts.higher++; }
+  else { counts.other++; }
+  if (dividedValue != expected) { counts.divisionWrong++; }
+}
+
+static void printCounts(const char * name, const Counts & counts)
+{
+  printf("%-30s  %8lu  %8lu  %6lu  %5lu  %14lu\n", name, counts.checked,
+    counts.same, counts.higher, counts.other, counts.divisionWrong);
+}
+
+int main()
+{
+  hostSetPinModel(&readings);
+
+  QTRSensors scaled;
+  QTRSensorsFixed<1, QTRBufferCalibration> divided;
+  setUp(scaled);
+  setUp(divided);
+
+  printf("check                           readings      same  1 more  other  division wrong\n");
+
+  Counts counts = {};
+  for (uint16_t range = 1; range <= 1023; range++)
+  {
+    setRange(scaled, 0, range);
+    setRange(divided, 0, range);
+    for (uint16_t reading = 0; reading <= range; reading++)
+    {
+      check(scaled, divided, range, reading, counts);
+    }
+  }
+  printCounts("10-bit ranges, every reading", counts);
+
+  counts = Counts();
+  for (uint32_t range = 1; range <= 65535; range++)
+  {
+    setRange(scaled, 0, range);
+    setRange(divided, 0, range);
+    check(scaled, divided, range, 0, counts);
+    check(scaled, divided, range, range - 1, counts);
+    check(scaled, divided, range, range, counts);
+
+    // the readings just below and at the steps to 1, 100, 200, ... 900
+    for (uint32_t step = 1; step < 1000; step += (step == 1) ? 99 : 100)
+    {
+      uint32_t reading = (step * range + 999) / 1000;
+      if ((reading == 0) || (reading >= range)) { continue; }
+      check(scaled, divided, range, reading - 1, counts);
+      check(scaled, divided, range, reading, counts);
+    }
+  }
+  printCounts("16-bit ranges, sampled", counts);
+
+  // Readings more than 32 times the range above the minimum.
+  counts = Counts();
+  setRange(scaled, 100, 110);
+  for (uint32_t reading = 430; reading <= 65535; reading += 5)
+  {
+    uint16_t value = readCalibrated(scaled, reading);
+    counts.checked++;
+    if (value == 1000) { counts.same++; } else { counts.other++; }
+  }
+  printf("readings far above a range of 10: %lu of %lu are 1000\n",
+    counts.same, counts.checked);
+}
@@ -0,0 +1,70 @@
+// Compares the frame time of back-to-back On reads with the emitters turned
+// on and off for every read (the default) and within an emitter session,
+// which leaves them on between reads.
+//
+// 8 RC sensors with dimmable emitters on pin 2, 10 frames each. The last
+// column says whether the reads within the session gave the same values as
+// the others.
+
+#include "HostSensors.h"
+#include <stdio.h>
+
+const uint8_t SensorPins[] = {4, 5, 6, 9, 10, 11, 12, 13};
+const uint8_t SensorCount = sizeof(SensorPins);
+const uint8_t Frames = 10;
+
+// Reads [Frames] frames in QTRReadMode::On and returns the average time
+// per frame.
+static double readFrames(QTRSensors & qtr, uint16_t * values, bool polled)
+{
+  double start = hostTime();
+  for (uint8_t frame = 0; frame < Frames; frame++)
+  {
+    if (polled)
+    {
+      qtr.startRead(values);
+      while (!qtr.poll()) {}
+    }
+    else
+    {
+      qtr.read(values);
+    }
+  }
+  return (hostTime() - start) / Frames;
+}
+
+int main()
+{
+  HostSensors sensors;
+  hostSetPinModel(&sensors);
+  for (uint8_t i = 0; i < SensorCount; i++)
+  {
+    HostSensor & sensor = sensors[SensorPins[i]];
+    sensor.rcDischarge = 300 + 250 * i;
+    sensor.ambient = 20 * i;
+    sensor.emitterPin = 2;
+  }
+
+  printf("call       normal  session\n");
+
+  for (uint8_t polled = 0; polled < 2; polled++)
+  {
+    QTRSensors qtr;
+    qtr.setTypeRC();
+    qtr.setSensorPins(SensorPins, SensorCount);
+    qtr.setEmitterPin(2);
+
+    uint16_t normalValues[SensorCount];
+    uint16_t sessionValues[SensorCount];
+    double normalTime = readFrames(qtr, normalValues, polled);
+    double sessionTime;
+    {
+      QTREmitterSession session(qtr);
+      sessionTime = readFrames(qtr, sessionValues, polled);
+    }
+
+    bool same = memcmp(normalValues, sessionValues, sizeof(normalValues)) == 0;
+    printf("%-9s  %6.0f  %7.0f  %s\n", polled ? "startRead" : "read",
+      normalTime, sessionTime, same ? "same" : "DIFFERENT");
+  }
+}
@@ -0,0 +1,87 @@
+// Compares the time taken to read two sensor arrays one after the other with
+// the time taken to read them together with QTRSensorGroup, in each read
+// mode.
+//
+// Two arrays of 4 sensors, on pins 4 to 7 with dimmable emitters on pin 2 and
+// on pins 8 to 11 with dimmable emitters on pin 3. The last column is the
+// largest difference between the values read each way.
+
+#include "HostSensors.h"
+#include <QTRSensorGroup.h>
+#include <stdio.h>
+
+const uint8_t PinsA[] = {4, 5, 6, 7};
+const uint8_t PinsB[] = {8, 9, 10, 11};
+const uint8_t SensorCount = 4;
+
+const char * const ModeNames[] = {"Off", "On", "OnAndOff", "OddEven", "OddEvenAndOff"};
+
+int main()
+{
+  HostSensors sensors;
+  hostSetPinModel(&sensors);
+  for (uint8_t i = 0; i < SensorCount; i++)
+  {
+    HostSensor & a = sensors[PinsA[i]];
+    a.rcDischarge = 300 + 400 * i;
+    a.analogLevel = 200 + 100 * i;
+    a.emitterPin = 2;
+
+    HostSensor & b = sensors[PinsB[i]];
+    b.rcDischarge = 1800 - 400 * i;
+    b.analogLevel = 900 - 100 * i;
+    b.emitterPin = 3;
+  }
+
+  printf("type    mode           separate  group  max difference\n");
+
+  for (uint8_t analog = 0; analog < 2; analog++)
+  {
+    for (uint8_t mode = 0; mode < 5; mode++)
+    {
+      QTRSensors a, b;
+      if (analog)
+      {
+        a.setTypeAnalog();
+        b.setTypeAnalog();
+      }
+      else
+      {
+        a.setTypeRC();
+        b.setTypeRC();
+      }
+      a.setSensorPins(PinsA, SensorCount);
+      b.setSensorPins(PinsB, SensorCount);
+      a.setEmitterPin(2);
+      b.setEmitterPin(3);
+
+      QTRSensors * const arrays[] = {&a, &b};
+      QTRSensorGroup group(arrays, 2);
+
+      uint16_t separateA[SensorCount], separateB[SensorCount];
+      uint16_t groupA[SensorCount], groupB[SensorCount];
+      uint16_t * const groupValues[] = {groupA, groupB};
+
+      double start = hostTime();
+      a.read(separateA, (QTRReadMode)mode);
+      b.read(separateB, (QTRReadMode)mode);
+      double separateTime = hostTime() - start;
+
+      start = hostTime();
+      group.read(groupValues, (QTRReadMode)mode);
+      double groupTime = hostTime() - start;
+
+      int maxDifference = 0;
+      for (uint8_t i = 0; i < SensorCount; i++)
+      {
+        int difference = abs((int)separateA[i] - (int)groupA[i]);
+        if (difference > maxDifference) { maxDifference = difference; }
+        difference = abs((int)separateB[i] - (int)groupB[i]);
+        if (difference > maxDifference) { maxDifference = difference; }
+      }
+
+      printf("%-7s %-14s %8.0f  %5.0f  %14d\n", analog ? "analog" : "RC",
+        ModeNames[mode], separateTime, groupTime, maxDifference);
+    }
+  }
+}
@@ -0,0 +1,130 @@
+// Measures the frame rate and the line position error of readLineBlack() in
+// each read mode, for RC sensors with different timeouts and analog sensors
+// with different numbers of samples per sensor.
+//
+// A black line one sensor pitch wide lies on a white surface under 8 RC
+// sensors on pins 3 to 10 or 6 analog sensors on A0 to A5, with dimmable
+// emitters on pins 2 (odd) and 11 (even). The emitters take 100 us to turn
+// on and 300 us to turn off, and each side lights the sensors of the other
+// side at 30% brightness. The sensors see uneven ambient light, and the
+// analog readings have +/-10 counts of noise. Each object is calibrated while
+// the line sweeps across the array, and then reads the line at 41 positions
+// spread across it. (In QTRReadMode::Off, the sensors cannot see the line.)
+// The error is in the units of readLineBlack(), where 1000 is the distance
+// between two sensors.
+
+#include "HostSensors.h"
+#include <stdio.h>
+
+const uint8_t RCPins[] = {3, 4, 5, 6, 7, 8, 9, 10};
+const uint8_t AnalogPins[] = {A0, A1, A2, A3, A4, A5};
+const double LineWidth = 1;
+const uint8_t TestPositions = 41;
+const uint8_t CalibrationPositions = 40;
+
+const char * const ModeNames[] = {"Off", "On", "OnAndOff", "OddEven", "OddEvenAndOff"};
+
+static HostSensors sensors;
+
+// Puts the center of the line under [position], where sensor i is at i, and
+// updates what each sensor sees: the part of its field of view (one sensor
+// pitch wide) that the line covers makes it darker.
+static void placeLine(const uint8_t * pins, uint8_t count, double position)
+{
+  for (uint8_t i = 0; i < count; i++)
+  {
+    double left = position - LineWidth / 2;
+    double right = position + LineWidth / 2;
+    if (left < i - 0.5) { left = i - 0.5; }
+    if (right > i + 0.5) { right = i + 0.5; }
+    double covered = (right > left) ? (right - left) : 0;
+
+    HostSensor & sensor = sensors[pins[i]];
+    sensor.rcLitFactor = 0.1 + 0.7 * covered;
+    sensor.analogLitDrop = 900 - 700 * covered;
+  }
+}
+
+int main()
+{
+  hostSetPinModel(&sensors);
+  sensors.emitterRiseTime = 100;
+  sensors.emitterFallTime = 300;
+  sensors.analogNoise = 10;
+  for (uint8_t i = 0; i < sizeof(RCPins); i++)
+  {
+    HostSensor & sensor = sensors[RCPins[i]];
+    sensor.rcDischarge = 3000;
+    sensor.ambient = 50 * i;
+    sensor.emitterPin = (i & 1) ? 11 : 2;
+    sensor.crosstalkEmitterPin = (i & 1) ? 2 : 11;
+    sensor.crosstalk = 0.3;
+  }
+  for (uint8_t i = 0; i < sizeof(AnalogPins); i++)
+  {
+    HostSensor & sensor = sensors[AnalogPins[i]];
+    sensor.analogLevel = 1000;
+    sensor.ambient = -20 * i;
+    sensor.emitterPin = (i & 1) ? 11 : 2;
+    sensor.crosstalkEmitterPin = (i & 1) ? 2 : 11;
+    sensor.crosstalk = 0.3;
+  }
+
+  printf("type    mode           timeout  samples  frames/s  mean error  max error\n");
+
+  for (uint8_t analog = 0; analog < 2; analog++)
+  {
+    const uint8_t * pins = analog ? AnalogPins : RCPins;
+    uint8_t count = analog ? sizeof(AnalogPins) : sizeof(RCPins);
+
+    for (uint8_t mode = 0; mode < 5; mode++)
+    {
+      for (uint8_t setting = 0; setting < 2; setting++)
+      {
+        QTRSensors qtr;
+        if (analog)
+        {
+          qtr.setTypeAnalog();
+          qtr.setSamplesPerSensor(setting ? 8 : 2);
+        }
+        else
+        {
+          qtr.setTypeRC();
+          qtr.setTimeout(setting ? 2500 : 1000);
+        }
+        qtr.setSensorPins(pins, count);
+        qtr.setEmitterPins(2, 11);
+
+        for (uint8_t i = 0; i < CalibrationPositions; i++)
+        {
+          placeLine(pins, count, -1 + (count + 1) * i / (CalibrationPositions - 1.0));
+          qtr.calibrate((QTRReadMode)mode);
+        }
+
+        double totalError = 0;
+        double maxError = 0;
+        double start = hostTime();
+        for (uint8_t i = 0; i < TestPositions; i++)
+        {
+          double position = (count - 1) * i / (TestPositions - 1.0);
+          placeLine(pins, count, position);
+          uint16_t values[8];
+          double error = (double)qtr.readLineBlack(values, (QTRReadMode)mode) - position * 1000;
+          if (error < 0) { error = -error; }
+          totalError += error;
+          if (error > maxError) { maxError = error; }
+        }
+        double frameTime = (hostTime() - start) / TestPositions;
+
+        char timeout[8] = "-";
+        char samples[8] = "-";
+        if (analog) { snprintf(samples, sizeof(samples), "%u", qtr.getSamplesPerSensor()); }
+        else { snprintf(timeout, sizeof(timeout), "%u", qtr.getTimeout()); }
+
+        printf("%-7s %-14s %7s  %7s  %8.0f  %10.0f  %9.0f\n",
+          analog ? "analog" : "RC", ModeNames[mode], timeout, samples,
+          1e6 / frameTime, totalError / TestPositions, maxError);
+      }
+    }
+  }
+}
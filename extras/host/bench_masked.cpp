@@ -0,0 +1,97 @@
+// Compares the time taken to read all of the sensors with the time taken by
+// readMasked() to read only the middle two (mask {0x18}), in each read mode.
+//
+// 8 RC sensors on pins 3 to 10, read with and without early exit, and 6
+// analog sensors on A0 to A5, with dimmable emitters on pins 2 (odd) and 11
+// (even). Each object is calibrated first. The last columns are the largest
+// difference between the values that readMasked() and readCalibratedMasked()
+// gave for the selected sensors and the values that read() and
+// readCalibrated() gave for them (RC readings can differ by the polling
+// resolution), and whether they left the other entries alone.
+
+#include "HostSensors.h"
+#include <stdio.h>
+
+const uint8_t RCPins[] = {3, 4, 5, 6, 7, 8, 9, 10};
+const uint8_t AnalogPins[] = {A0, A1, A2, A3, A4, A5};
+const uint8_t Mask[] = {0x18};
+const uint16_t Unset = 12345;
+
+const char * const ModeNames[] = {"Off", "On", "OnAndOff", "OddEven", "OddEvenAndOff"};
+
+int main()
+{
+  HostSensors sensors;
+  hostSetPinModel(&sensors);
+  for (uint8_t i = 0; i < sizeof(RCPins); i++)
+  {
+    sensors[RCPins[i]].rcDischarge = 300 + 150 * i;
+    sensors[RCPins[i]].emitterPin = (i & 1) ? 11 : 2;
+  }
+  for (uint8_t i = 0; i < sizeof(AnalogPins); i++)
+  {
+    sensors[AnalogPins[i]].analogLevel = 400 + 90 * i;
+    sensors[AnalogPins[i]].emitterPin = (i & 1) ? 11 : 2;
+  }
+
+  printf("type           mode           all sensors  mask 0x18  max difference  others\n");
+
+  for (uint8_t type = 0; type < 3; type++)
+  {
+    for (uint8_t mode = 0; mode < 5; mode++)
+    {
+      QTRSensors qtr;
+      uint8_t count;
+      if (type == 2)
+      {
+        qtr.setTypeAnalog();
+        qtr.setSensorPins(AnalogPins, sizeof(AnalogPins));
+        count = sizeof(AnalogPins);
+      }
+      else
+      {
+        qtr.setTypeRC();
+        qtr.setSensorPins(RCPins, sizeof(RCPins));
+        qtr.setEarlyExit(type == 1);
+        count = sizeof(RCPins);
+      }
+      qtr.setEmitterPins(2, 11);
+      for (uint8_t i = 0; i < 3; i++) { qtr.calibrate((QTRReadMode)mode); }
+
+      uint16_t all[8], calibratedAll[8];
+      double start = hostTime();
+      qtr.read(all, (QTRReadMode)mode);
+      double allTime = hostTime() - start;
+      qtr.readCalibrated(calibratedAll, (QTRReadMode)mode);
+
+      uint16_t masked[8], calibratedMasked[8];
+      for (uint8_t i = 0; i < 8; i++) { masked[i] = calibratedMasked[i] = Unset; }
+      start = hostTime();
+      qtr.readMasked(masked, Mask, (QTRReadMode)mode);
+      double maskedTime = hostTime() - start;
+      qtr.readCalibratedMasked(calibratedMasked, Mask, (QTRReadMode)mode);
+
+      int maxDifference = 0;
+      bool othersLeft = true;
+      for (uint8_t i = 0; i < count; i++)
+      {
+        if ((Mask[i / 8] >> (i % 8)) & 1)
+        {
+          int difference = abs((int)masked[i] - (int)all[i]);
+          if (difference > maxDifference) { maxDifference = difference; }
+          difference = abs((int)calibratedMasked[i] - (int)calibratedAll[i]);
+          if (difference > maxDifference) { maxDifference = difference; }
+        }
+        else
+        {
+          othersLeft = othersLeft && (masked[i] == Unset) && (calibratedMasked[i] == Unset);
+        }
+      }
+
+      printf("%-13s  %-14s %11.0f  %9.0f  %14d  %s\n",
+        (type == 2) ? "analog" : ((type == 1) ? "RC early exit" : "RC"),
+        ModeNames[mode], allTime, maskedTime, maxDifference,
+        othersLeft ? "left alone" : "OVERWRITTEN");
+    }
+  }
+}
@@ -0,0 +1,81 @@
+// Compares the frame time of OnAndOff and OddEvenAndOff reads with the off
+// readings taken last (the default) and first (setOffFirst(true)), with
+// different amounts of other work between frames. Taking them first lets the
+// emitters turn off while the sketch does that other work, instead of the
+// read waiting for them.
+//
+// 8 sensors with dimmable emitters on pins 2 (odd) and 3 (even), 20 frames
+// each. While waiting for a non-blocking read, the sketch does 5 us of other
+// work between calls to poll(). The last column says whether both orders
+// gave the same values.
+
+#include "HostSensors.h"
+#include <stdio.h>
+
+const uint8_t SensorPins[] = {4, 5, 6, 9, 10, 11, 12, 13};
+const uint8_t SensorCount = sizeof(SensorPins);
+const uint8_t Frames = 20;
+const QTRReadMode Modes[] = {QTRReadMode::OnAndOff, QTRReadMode::OddEvenAndOff};
+
+int main()
+{
+  HostSensors sensors;
+  hostSetPinModel(&sensors);
+  for (uint8_t i = 0; i < SensorCount; i++)
+  {
+    HostSensor & sensor = sensors[SensorPins[i]];
+    sensor.rcDischarge = 300 + 250 * i;
+    sensor.analogLevel = 400 + 50 * i;
+    sensor.ambient = 20 * i;
+    sensor.emitterPin = (i & 1) ? 3 : 2;
+  }
+
+  printf("type    mode           gap   call       off last  off first  difference\n");
+
+  for (uint8_t analog = 0; analog < 2; analog++)
+  {
+    for (QTRReadMode mode : Modes)
+    {
+      for (uint16_t gap = 0; gap <= 2000; gap += 1000)
+      {
+        for (uint8_t polled = 0; polled < 2; polled++)
+        {
+          uint16_t values[2][SensorCount];
+          double frameTime[2];
+
+          for (uint8_t offFirst = 0; offFirst < 2; offFirst++)
+          {
+            QTRSensors qtr;
+            if (analog) { qtr.setTypeAnalog(); } else { qtr.setTypeRC(); }
+            qtr.setSensorPins(SensorPins, SensorCount);
+            qtr.setEmitterPins(2, 3);
+            qtr.setOffFirst(offFirst);
+
+            double start = hostTime();
+            for (uint8_t frame = 0; frame < Frames; frame++)
+            {
+              if (polled)
+              {
+                qtr.startRead(values[offFirst], mode);
+                while (!qtr.poll()) { hostAdvance(5); }
+              }
+              else
+              {
+                qtr.read(values[offFirst], mode);
+              }
+              hostAdvance(gap);
+            }
+            frameTime[offFirst] = (hostTime() - start) / Frames - gap;
+          }
+
+          bool same = memcmp(values[0], values[1], sizeof(values[0])) == 0;
+          printf("%-7s %-14s %4u  %-9s  %8.0f  %9.0f  %10.0f  %s\n",
+            analog ? "analog" : "RC",
+            (mode == QTRReadMode::OnAndOff) ? "OnAndOff" : "OddEvenAndOff",
+            gap, polled ? "startRead" : "read", frameTime[0], frameTime[1],
+            frameTime[1] - frameTime[0], same ? "same" : "DIFFERENT");
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,88 @@
+// Compares the frame time of OnAndOff and OddEvenAndOff reads that take new
+// off readings every frame (the default) with reads that reuse them for 4 or
+// 10 frames (setOffRefreshInterval()).
+//
+// 8 sensors with dimmable emitters on pins 2 (odd) and 3 (even) under
+// constant ambient light, 40 frames each, with 500 us of other work between
+// frames. While waiting for a non-blocking read, the sketch does 5 us of
+// other work between calls to poll(). The last column says whether every
+// frame gave the same values.
+
+#include "HostSensors.h"
+#include <stdio.h>
+
+const uint8_t SensorPins[] = {4, 5, 6, 9, 10, 11, 12, 13};
+const uint8_t SensorCount = sizeof(SensorPins);
+const uint8_t Frames = 40;
+const uint16_t Gap = 500;
+const uint8_t Intervals[] = {1, 4, 10};
+const QTRReadMode Modes[] = {QTRReadMode::OnAndOff, QTRReadMode::OddEvenAndOff};
+
+int main()
+{
+  HostSensors sensors;
+  hostSetPinModel(&sensors);
+  for (uint8_t i = 0; i < SensorCount; i++)
+  {
+    HostSensor & sensor = sensors[SensorPins[i]];
+    sensor.rcDischarge = 300 + 250 * i;
+    sensor.analogLevel = 400 + 50 * i;
+    sensor.ambient = 20 * i;
+    sensor.emitterPin = (i & 1) ? 3 : 2;
+  }
+
+  printf("type    mode           off first  call       interval 1  interval 4  interval 10\n");
+
+  for (uint8_t analog = 0; analog < 2; analog++)
+  {
+    for (QTRReadMode mode : Modes)
+    {
+      for (uint8_t offFirst = 0; offFirst < 2; offFirst++)
+      {
+        for (uint8_t polled = 0; polled < 2; polled++)
+        {
+          uint16_t firstValues[SensorCount];
+          double frameTime[sizeof(Intervals)];
+          bool same = true;
+
+          for (uint8_t k = 0; k < sizeof(Intervals); k++)
+          {
+            QTRSensors qtr;
+            if (analog) { qtr.setTypeAnalog(); } else { qtr.setTypeRC(); }
+            qtr.setSensorPins(SensorPins, SensorCount);
+            qtr.setEmitterPins(2, 3);
+            qtr.setOffFirst(offFirst);
+            qtr.setOffRefreshInterval(Intervals[k]);
+
+            double start = hostTime();
+            for (uint8_t frame = 0; frame < Frames; frame++)
+            {
+              uint16_t values[SensorCount];
+              if (polled)
+              {
+                qtr.startRead(values, mode);
+                while (!qtr.poll()) { hostAdvance(5); }
+              }
+              else
+              {
+                qtr.read(values, mode);
+              }
+
+              if ((k == 0) && (frame == 0)) { memcpy(firstValues, values, sizeof(values)); }
+              same = same && (memcmp(values, firstValues, sizeof(values)) == 0);
+
+              hostAdvance(Gap);
+            }
+            frameTime[k] = (hostTime() - start) / Frames - Gap;
+          }
+
+          printf("%-7s %-14s %-9s  %-9s  %10.0f  %10.0f  %11.0f  %s\n",
+            analog ? "analog" : "RC",
+            (mode == QTRReadMode::OnAndOff) ? "OnAndOff" : "OddEvenAndOff",
+            offFirst ? "yes" : "no", polled ? "startRead" : "read",
+            frameTime[0], frameTime[1], frameTime[2], same ? "same" : "DIFFERENT");
+        }
+      }
+    }
+  }
+}
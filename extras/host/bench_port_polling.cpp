@@ -0,0 +1,79 @@
+// Compares the poll period of the RC discharge loop when the sensors are
+// polled one pin at a time with digitalRead() and one I/O port at a time, for
+// different numbers of sensors. The poll period is the resolution of the
+// readings.
+//
+// Up to 16 RC sensors on pins 3 to 18, read in QTRReadMode::Off with a
+// timeout of 2500 us. Polling with digitalRead() is forced by using a
+// QTRSensorsFixed without QTRBufferPortPolling. The poll period is the time
+// from the release of the lines to the end of the read, divided by the
+// number of times the loop polled the sensors. Reading a port register takes
+// no time on the simulated board, so the port polling period only includes
+// the call to micros() (on a real AVR, reading a port takes a couple of
+// cycles).
+//
+// Port polling is only available in the avr flavor; in the generic flavor,
+// both columns use digitalRead().
+
+#include "HostSensors.h"
+#include <stdio.h>
+
+const uint8_t SensorPins[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18};
+const uint8_t MaxSensors = sizeof(SensorPins);
+const uint16_t Timeout = 2500;
+
+// The sensor model, which also notes the time and the number of calls to
+// micros() when the last line is released.
+class Sensors : public HostSensors
+{
+  public:
+    void drivenChanged(uint8_t pin, bool high) override
+    {
+      HostSensors::drivenChanged(pin, high);
+      if (!high && (hostPinMode(pin) != OUTPUT))
+      {
+        releaseTime = hostTime();
+        releaseMicrosCalls = hostCalls.micros;
+      }
+    }
+
+    double releaseTime;
+    unsigned long releaseMicrosCalls;
+};
+
+static Sensors sensors;
+
+// Reads the sensors and returns the poll period.
+static double pollPeriod(QTRSensors & qtr, uint8_t count)
+{
+  qtr.setTypeRC();
+  qtr.setSensorPins(SensorPins, count);
+  qtr.setTimeout(Timeout);
+
+  uint16_t values[MaxSensors];
+  qtr.read(values, QTRReadMode::Off);
+
+  // Each pass through the discharge loop calls micros() once.
+  return (hostTime() - sensors.releaseTime) /
+    (hostCalls.micros - sensors.releaseMicrosCalls);
+}
+
+int main()
+{
+  hostSetPinModel(&sensors);
+  for (uint8_t i = 0; i < MaxSensors; i++)
+  {
+    sensors[SensorPins[i]].rcDischarge = 300 + 100 * i;
+  }
+
+  printf("sensors  digitalRead period  port polling period\n");
+
+  for (uint8_t count = 1; count <= MaxSensors; count *= 2)
+  {
+    QTRSensorsFixed<MaxSensors, QTRBufferCalibration> pinPolled;
+    QTRSensors portPolled;
+
+    printf("%7u  %18.1f  %19.1f\n", count,
+      pollPeriod(pinPolled, count), pollPeriod(portPolled, count));
+  }
+}
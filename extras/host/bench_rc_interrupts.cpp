@@ -0,0 +1,159 @@
+// Compares RC readings timed with interrupts (QTRRCTiming::Interrupt) with
+// polled readings, and shows the cases in which interrupt timing falls back
+// to polling.
+//
+// 8 RC sensors on pins 4 to 11, read in QTRReadMode::Off with a timeout of
+// 2500 us, with read() or with startRead() followed by calls to poll() with
+// 0, 250 or 500 us of other work between them. In the avr flavor, the sensor
+// pins are on two ports, and the pin change interrupt handlers are defined
+// with QTR_PCINT_ISR; in the generic flavor, attachInterrupt() is used. The
+// difference is the largest difference from the values of a polled read().
+//
+// The fallbacks are read with calls to poll() 500 us apart, so a difference
+// close to 500 shows that the sensors were polled:
+//
+// - another object is in the middle of an interrupt-timed read, so it owns
+//   the interrupt handlers;
+// - in the generic flavor, there are more than 31 sensors (32 on pins 4 to
+//   35), which attachInterrupt() has no handlers for. This program is built
+//   with QTR_MAX_SENSORS set to 40 so that they can be used; the avr flavor
+//   does not have enough pins.
+//
+// bench_rc_interrupts_no_isr shows what happens if the handlers are missing.
+
+#include "HostSensors.h"
+#include <stdio.h>
+
+QTR_PCINT_ISR
+
+const uint8_t SensorPins[] = {4, 5, 6, 7, 8, 9, 10, 11};
+const uint8_t SensorCount = sizeof(SensorPins);
+const uint16_t Timeout = 2500;
+
+#if !defined(__AVR__)
+const uint8_t ManyCount = 32;
+#endif
+
+struct Result
+{
+  double time;
+  int difference;
+  unsigned long interrupts;
+};
+
+static void setUp(QTRSensors & qtr, const uint8_t * pins, uint8_t count,
+                  QTRRCTiming timing)
+{
+  qtr.setTypeRC();
+  qtr.setSensorPins(pins, count);
+  qtr.setTimeout(Timeout);
+  qtr.setRCTiming(timing);
+}
+
+// Reads the sensors with read() if [interval] is negative, or with
+// startRead() and poll(), and compares the values with [expected].
+static Result measure(QTRSensors & qtr, double interval, const uint16_t * expected)
+{
+  uint16_t values[QTRMaxSensors];
+  unsigned long interrupts = hostCalls.interrupts;
+  double start = hostTime();
+
+  if (interval < 0)
+  {
+    qtr.read(values, QTRReadMode::Off);
+  }
+  else
+  {
+    qtr.startRead(values, QTRReadMode::Off);
+    while (!qtr.poll()) { hostAdvance(interval); }
+  }
+
+  Result result = {};
+  result.time = hostTime() - start;
+  result.interrupts = hostCalls.interrupts - interrupts;
+  for (uint8_t i = 0; i < qtr.getSensorCount(); i++)
+  {
+    int difference = abs((int)values[i] - (int)expected[i]);
+    if (difference > result.difference) { result.difference = difference; }
+  }
+  return result;
+}
+
+static void printResult(const char * name, const char * call, const Result & result)
+{
+  printf("%-32s  %-14s  %9.0f  %10d  %10lu\n", name, call, result.time,
+    result.difference, result.interrupts);
+}
+
+int main()
+{
+  HostSensors sensors;
+  hostSetPinModel(&sensors);
+  for (uint8_t pin = 4; pin < HostPinCount; pin++)
+  {
+    sensors[pin].rcDischarge = 310 + 97 * (pin % 20);
+  }
+
+  // the values of a polled read() to compare with
+  uint16_t expected[SensorCount];
+  {
+    QTRSensors qtr;
+    setUp(qtr, SensorPins, SensorCount, QTRRCTiming::Polled);
+    qtr.read(expected, QTRReadMode::Off);
+  }
+
+  printf("timing                            call            time (us)  difference  interrupts\n");
+
+  const double Intervals[] = {-1, 0, 250, 500};
+  const char * const Calls[] = {"read()", "poll()", "poll() /250 us", "poll() /500 us"};
+
+  for (uint8_t interrupt = 0; interrupt < 2; interrupt++)
+  {
+    QTRSensors qtr;
+    setUp(qtr, SensorPins, SensorCount,
+      interrupt ? QTRRCTiming::Interrupt : QTRRCTiming::Polled);
+
+    for (uint8_t call = 0; call < 4; call++)
+    {
+      printResult(interrupt ? "Interrupt" : "Polled", Calls[call],
+        measure(qtr, Intervals[call], expected));
+    }
+  }
+
+  // Another object owns the handlers while its read is in progress. Its
+  // lines take too long to discharge to cause any interrupts meanwhile.
+  {
+    const uint8_t OwnerPins[] = {12, 13};
+    sensors[12].rcDischarge = 40000;
+    sensors[13].rcDischarge = 40000;
+
+    QTRSensors owner;
+    setUp(owner, OwnerPins, 2, QTRRCTiming::Interrupt);
+    owner.setTimeout(32767);
+    uint16_t ownerValues[2];
+    owner.startRead(ownerValues, QTRReadMode::Off);
+    owner.poll(); // charges and releases the lines
+
+    QTRSensors qtr;
+    setUp(qtr, SensorPins, SensorCount, QTRRCTiming::Interrupt);
+    printResult("Interrupt, handlers owned", Calls[3], measure(qtr, 500, expected));
+
+    owner.cancelRead();
+  }
+
+#if !defined(__AVR__)
+  {
+    uint8_t pins[ManyCount];
+    for (uint8_t i = 0; i < ManyCount; i++) { pins[i] = 4 + i; }
+
+    uint16_t manyExpected[ManyCount];
+    QTRSensors polled;
+    setUp(polled, pins, ManyCount, QTRRCTiming::Polled);
+    polled.read(manyExpected, QTRReadMode::Off);
+
+    QTRSensors qtr;
+    setUp(qtr, pins, ManyCount, QTRRCTiming::Interrupt);
+    printResult("Interrupt, 32 sensors", Calls[3], measure(qtr, 500, manyExpected));
+  }
+#endif
+}
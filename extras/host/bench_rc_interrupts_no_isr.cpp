@@ -0,0 +1,58 @@
+// Shows what QTRRCTiming::Interrupt does when the pin change interrupt
+// handlers have not been defined with QTR_PCINT_ISR.
+//
+// The same sensors and reads as bench_rc_interrupts, but this program does
+// not use QTR_PCINT_ISR. In the avr flavor, interrupt timing falls back to
+// polling, so the values read with calls to poll() 500 us apart differ from
+// those of a polled read() by close to 500, and no interrupts run. In the
+// generic flavor, attachInterrupt() needs no handlers from the sketch, so
+// interrupt timing is used.
+
+#include "HostSensors.h"
+#include <stdio.h>
+
+const uint8_t SensorPins[] = {4, 5, 6, 7, 8, 9, 10, 11};
+const uint8_t SensorCount = sizeof(SensorPins);
+const uint16_t Timeout = 2500;
+
+int main()
+{
+  HostSensors sensors;
+  hostSetPinModel(&sensors);
+  for (uint8_t i = 0; i < SensorCount; i++)
+  {
+    sensors[SensorPins[i]].rcDischarge = 310 + 97 * SensorPins[i];
+  }
+
+  printf("timing     call            time (us)  difference  interrupts\n");
+
+  uint16_t expected[SensorCount];
+  QTRSensors polled;
+  polled.setTypeRC();
+  polled.setSensorPins(SensorPins, SensorCount);
+  polled.setTimeout(Timeout);
+  polled.read(expected, QTRReadMode::Off);
+
+  QTRSensors qtr;
+  qtr.setTypeRC();
+  qtr.setSensorPins(SensorPins, SensorCount);
+  qtr.setTimeout(Timeout);
+  qtr.setRCTiming(QTRRCTiming::Interrupt);
+
+  uint16_t values[SensorCount];
+  unsigned long interrupts = hostCalls.interrupts;
+  double start = hostTime();
+  qtr.startRead(values, QTRReadMode::Off);
+  while (!qtr.poll()) { hostAdvance(500); }
+  double time = hostTime() - start;
+
+  int maxDifference = 0;
+  for (uint8_t i = 0; i < SensorCount; i++)
+  {
+    int difference = abs((int)values[i] - (int)expected[i]);
+    if (difference > maxDifference) { maxDifference = difference; }
+  }
+
+  printf("Interrupt  poll() /500 us  %9.0f  %10d  %10lu\n", time, maxDifference,
+    hostCalls.interrupts - interrupts);
+}
@@ -0,0 +1,96 @@
+// Measures the frame time of each read mode, and the Arduino core calls a
+// frame makes, for blocking and non-blocking reads of RC and analog sensors.
+//
+// The sensors are ideal: every RC line discharges 1000 us after it is
+// released and every analog input reads 500, whatever the emitters do, so
+// the times only depend on the library's own work and waits. With the default
+// timeout of 2500 us and no early exit, every RC pass waits for the timeout.
+
+#include <QTRSensors.h>
+#include "HostArduino.h"
+#include <stdio.h>
+
+class IdealSensors : public HostPinModel
+{
+  public:
+    void drivenChanged(uint8_t pin, bool high) override
+    {
+      dischargeAt[pin] = high ? 1e300 : hostTime() + 1000;
+    }
+
+    bool inputLevel(uint8_t pin) override
+    {
+      return hostTime() < dischargeAt[pin];
+    }
+
+    int analogInput(uint8_t pin) override
+    {
+      (void)pin;
+      return 500;
+    }
+
+  private:
+    double dischargeAt[HostPinCount] = {};
+};
+
+const uint8_t RCPins[] = {3, 4, 5, 6, 7, 8, 9, 10};
+const uint8_t AnalogPins[] = {A0, A1, A2, A3, A4, A5};
+const uint8_t EmitterPin = 2;
+const uint8_t Frames = 10;
+
+const char * const ModeNames[] = {"Off", "On", "OnAndOff", "OddEven", "OddEvenAndOff"};
+
+int main()
+{
+  IdealSensors sensors;
+  hostSetPinModel(&sensors);
+
+  printf("type    mode           call       us/frame  micros  digitalRead  digitalWrite  pinMode  analogRead\n");
+
+  for (uint8_t analog = 0; analog < 2; analog++)
+  {
+    for (uint8_t mode = 0; mode < 5; mode++)
+    {
+      for (uint8_t polled = 0; polled < 2; polled++)
+      {
+        QTRSensors qtr;
+        if (analog)
+        {
+          qtr.setTypeAnalog();
+          qtr.setSensorPins(AnalogPins, sizeof(AnalogPins));
+        }
+        else
+        {
+          qtr.setTypeRC();
+          qtr.setSensorPins(RCPins, sizeof(RCPins));
+        }
+        qtr.setEmitterPin(EmitterPin);
+
+        uint16_t values[8];
+        hostCalls = HostCallCounts();
+        double start = hostTime();
+        for (uint8_t frame = 0; frame < Frames; frame++)
+        {
+          if (polled)
+          {
+            qtr.startRead(values, (QTRReadMode)mode);
+            while (!qtr.poll()) {}
+          }
+          else
+          {
+            qtr.read(values, (QTRReadMode)mode);
+          }
+        }
+
+        printf("%-7s %-14s %-10s %8.0f  %6.1f  %11.1f  %12.1f  %7.1f  %10.1f\n",
+          analog ? "analog" : "RC", ModeNames[mode], polled ? "startRead" : "read",
+          (hostTime() - start) / Frames,
+          (double)hostCalls.micros / Frames,
+          (double)hostCalls.digitalRead / Frames,
+          (double)hostCalls.digitalWrite / Frames,
+          (double)hostCalls.pinMode / Frames,
+          (double)hostCalls.analogRead / Frames);
+      }
+    }
+  }
+}
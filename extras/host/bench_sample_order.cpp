@@ -0,0 +1,71 @@
+// Compares the analog sample orders (setSampleOrder()) with an ADC that
+// leaks 20% of the previous conversion into the first conversion after it
+// switches channels, for different numbers of samples per sensor and sample
+// reductions.
+//
+// 6 analog sensors on A0 to A5 whose true readings alternate between 100 and
+// 900, read in QTRReadMode::Off. The error is the largest difference between
+// a value and the true reading, for a blocking read() and for the
+// startRead() and poll() calls that follow it.
+
+#include "HostSensors.h"
+#include <stdio.h>
+
+const uint8_t SensorPins[] = {A0, A1, A2, A3, A4, A5};
+const uint8_t SensorCount = sizeof(SensorPins);
+const int TrueValues[SensorCount] = {100, 900, 100, 900, 100, 900};
+
+const char * const OrderNames[] = {"Interleaved", "Burst", "BurstDiscardFirst"};
+
+static int maxError(const uint16_t * values)
+{
+  int error = 0;
+  for (uint8_t i = 0; i < SensorCount; i++)
+  {
+    int e = abs((int)values[i] - TrueValues[i]);
+    if (e > error) { error = e; }
+  }
+  return error;
+}
+
+int main()
+{
+  HostSensors sensors;
+  hostSetPinModel(&sensors);
+  sensors.adcCrosstalk = 0.2;
+  for (uint8_t i = 0; i < SensorCount; i++)
+  {
+    sensors[SensorPins[i]].analogLevel = TrueValues[i];
+  }
+
+  printf("reduction  order              samples   time  read error  startRead error\n");
+
+  for (uint8_t median = 0; median < 2; median++)
+  {
+    for (uint8_t order = 0; order < 3; order++)
+    {
+      for (uint8_t samples = 1; samples <= 8; samples *= 2)
+      {
+        QTRSensors qtr;
+        qtr.setTypeAnalog();
+        qtr.setSensorPins(SensorPins, SensorCount);
+        qtr.setSamplesPerSensor(samples);
+        qtr.setSampleOrder((QTRSampleOrder)order);
+        qtr.setSampleReduction(median ? QTRSampleReduction::Median : QTRSampleReduction::Mean);
+
+        uint16_t values[SensorCount];
+        double start = hostTime();
+        qtr.read(values, QTRReadMode::Off);
+        double time = hostTime() - start;
+        int readError = maxError(values);
+
+        qtr.startRead(values, QTRReadMode::Off);
+        while (!qtr.poll()) {}
+        int pollError = maxError(values);
+
+        printf("%-9s  %-17s  %7u  %5.0f  %10d  %15d\n", median ? "Median" : "Mean",
+          OrderNames[order], samples, time, readError, pollError);
+      }
+    }
+  }
+}
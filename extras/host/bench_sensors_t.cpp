@@ -0,0 +1,121 @@
+// Compares the time QTRSensors and QTRSensorsT take to read the same sensors
+// in each read mode, and the calls they make to pinMode() and digitalRead().
+//
+// 8 RC sensors on pins 4 to 11 (on two ports in the avr flavor) with a
+// timeout of 2500 us, and 6 analog sensors on A0 to A5, with emitters on pin
+// 2. In the avr flavor, QTRSensorsT charges, releases, and polls the RC lines
+// through the port registers, which take no time on the simulated board; in
+// the generic flavor, and for analog sensors, it reads like QTRSensors. The
+// last rows read with startRead() and poll(), which go through the same code
+// for both.
+//
+// The last column is the largest difference between the values they read.
+// Because QTRSensorsT releases all of the RC lines at once instead of with
+// one call to pinMode() after another, its readings of the lines released
+// last by QTRSensors are slightly longer.
+
+#include "HostSensors.h"
+#include <stdio.h>
+
+const uint8_t RCPins[] = {4, 5, 6, 7, 8, 9, 10, 11};
+const uint8_t AnalogPins[] = {A0, A1, A2, A3, A4, A5};
+const uint8_t MaxSensors = 8;
+
+const char * const ModeNames[] = {"Off", "On", "OnAndOff", "OddEven", "OddEvenAndOff"};
+
+struct Result
+{
+  double time;
+  unsigned long pinModeCalls;
+  unsigned long digitalReadCalls;
+};
+
+static Result measure(QTRSensors & qtr, QTRReadMode mode, bool polled,
+                      uint16_t * values)
+{
+  HostCallCounts calls = hostCalls;
+  double start = hostTime();
+
+  if (polled)
+  {
+    qtr.startRead(values, mode);
+    while (!qtr.poll()) {}
+  }
+  else
+  {
+    qtr.read(values, mode);
+  }
+
+  Result result;
+  result.time = hostTime() - start;
+  result.pinModeCalls = hostCalls.pinMode - calls.pinMode;
+  result.digitalReadCalls = hostCalls.digitalRead - calls.digitalRead;
+  return result;
+}
+
+static void compare(const char * type, QTRSensors & plain, QTRSensors & fixed,
+                    bool polled)
+{
+  for (uint8_t mode = 0; mode < 5; mode++)
+  {
+    uint16_t plainValues[MaxSensors], fixedValues[MaxSensors];
+    Result a = measure(plain, (QTRReadMode)mode, polled, plainValues);
+    Result b = measure(fixed, (QTRReadMode)mode, polled, fixedValues);
+
+    int maxDifference = 0;
+    for (uint8_t i = 0; i < plain.getSensorCount(); i++)
+    {
+      int difference = abs((int)plainValues[i] - (int)fixedValues[i]);
+      if (difference > maxDifference) { maxDifference = difference; }
+    }
+
+    char aCalls[24], bCalls[24];
+    snprintf(aCalls, sizeof(aCalls), "%lu/%lu", a.pinModeCalls, a.digitalReadCalls);
+    snprintf(bCalls, sizeof(bCalls), "%lu/%lu", b.pinModeCalls, b.digitalReadCalls);
+
+    printf("%-6s  %-6s  %-13s  %10.0f  %11.0f  %10s  %11s  %14d\n",
+      type, polled ? "poll()" : "read()", ModeNames[mode], a.time, b.time,
+      aCalls, bCalls, maxDifference);
+  }
+}
+
+int main()
+{
+  HostSensors sensors;
+  hostSetPinModel(&sensors);
+  for (uint8_t i = 0; i < sizeof(RCPins); i++)
+  {
+    HostSensor & sensor = sensors[RCPins[i]];
+    sensor.rcDischarge = 400 + 250 * i;
+    sensor.ambient = 10 * i;
+    sensor.emitterPin = 2;
+  }
+  for (uint8_t i = 0; i < sizeof(AnalogPins); i++)
+  {
+    HostSensor & sensor = sensors[AnalogPins[i]];
+    sensor.analogLevel = 400 + 100 * i;
+    sensor.emitterPin = 2;
+  }
+
+  printf("                                  time (us)             "
+    "pinMode/digitalRead\n");
+  printf("type    call    mode           QTRSensors  QTRSensorsT  QTRSensors"
+    "  QTRSensorsT  max difference\n");
+
+  QTRSensors rc;
+  rc.setTypeRC();
+  rc.setSensorPins(RCPins, sizeof(RCPins));
+  rc.setEmitterPin(2);
+  QTRSensorsT<QTRType::RC, 4, 5, 6, 7, 8, 9, 10, 11> rcT;
+  rcT.setEmitterPin(2);
+  compare("RC", rc, rcT, false);
+  compare("RC", rc, rcT, true);
+
+  QTRSensors analog;
+  analog.setTypeAnalog();
+  analog.setSensorPins(AnalogPins, sizeof(AnalogPins));
+  analog.setEmitterPin(2);
+  QTRSensorsT<QTRType::Analog, A0, A1, A2, A3, A4, A5> analogT;
+  analogT.setEmitterPin(2);
+  compare("analog", analog, analogT, false);
+}